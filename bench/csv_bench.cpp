@@ -0,0 +1,222 @@
+// Parse/write benchmark for csv.hpp over synthetic datasets.
+//
+// Build (no other dependencies):
+//     g++ -std=c++17 -O2 -march=native -pthread -I.. csv_bench.cpp -o csv_bench
+//
+// Usage:
+//     csv_bench [--size MB] [--threads N] [--repeat N] [--dataset NAME] [--dump FILE]
+//
+// Datasets: narrow, wide, numeric, string, quoted, crlf (default: all).
+// Each benchmark prints MB/s, rows/s and the peak RSS so far; run one
+// dataset per process (--dataset) for comparable RSS figures. --dump writes
+// the data of the dataset named by --dataset to FILE instead of benchmarking it.
+
+#include "csv.hpp"
+
+#include <chrono>
+#include <random>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#endif
+
+using tabxx::CSV;
+
+namespace {
+
+struct Dataset {
+    const char* name;
+    std::size_t columns;
+    int kind; // 0 mixed, 1 numeric, 2 string, 3 quoted
+    bool crlf;
+};
+
+const Dataset DATASETS[] = {
+    {"narrow", 4, 0, false},
+    {"wide", 64, 0, false},
+    {"numeric", 16, 1, false},
+    {"string", 16, 2, false},
+    {"quoted", 8, 3, false},
+    {"crlf", 8, 0, true},
+};
+
+// Generates about `bytes` of CSV text; returns the number of data rows.
+std::size_t generate(const Dataset& d, std::size_t bytes, std::string& out) {
+    std::mt19937_64 rng(42);
+    const char* ending = d.crlf ? "\r\n" : "\n";
+    out.clear();
+    out.reserve(bytes + 4096);
+    for (std::size_t j = 0; j < d.columns; ++j) {
+        if (j != 0)
+            out += ',';
+        out += "col" + std::to_string(j);
+    }
+    out += ending;
+    std::size_t rows = 0;
+    char buf[64];
+    while (out.size() < bytes) {
+        for (std::size_t j = 0; j < d.columns; ++j) {
+            if (j != 0)
+                out += ',';
+            int kind = d.kind == 0 ? static_cast<int>(j % 3) : d.kind;
+            std::uint64_t r = rng();
+            if (kind == 1 || (kind == 0 && j % 3 == 0)) {
+                if (j % 2 == 0)
+                    out.append(buf, std::to_chars(buf, buf + sizeof(buf), static_cast<long long>(r % 1000000) - 500000).ptr);
+                else
+                    out.append(buf, std::snprintf(buf, sizeof(buf), "%.3f", static_cast<double>(r % 10000000) / 1000));
+            }
+            else if (kind == 3) {
+                out += '"';
+                out += "v" + std::to_string(r % 1000);
+                out += (r & 1) ? ", \"\"q\"\"" : " x";
+                out += '"';
+            }
+            else {
+                static const char letters[] = "abcdefghijklmnopqrstuvwxyz";
+                std::size_t n = 4 + r % 12;
+                for (std::size_t k = 0; k < n; ++k)
+                    out += letters[(r >> (k * 4)) % 26];
+            }
+        }
+        out += ending;
+        ++rows;
+    }
+    return rows;
+}
+
+long peakRssKiB() {
+#if defined(__unix__) || defined(__APPLE__)
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+#ifdef __APPLE__
+    return ru.ru_maxrss / 1024;
+#else
+    return ru.ru_maxrss;
+#endif
+#else
+    return -1;
+#endif
+}
+
+// Runs f `repeat` times and reports the fastest run.
+template <typename F>
+void measure(const char* dataset, const char* bench, std::size_t bytes, std::size_t rows, int repeat, F&& f) {
+    double best = 1e100;
+    for (int i = 0; i < repeat; ++i) {
+        auto start = std::chrono::steady_clock::now();
+        f();
+        double s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        best = std::min(best, s);
+    }
+    std::printf("%-8s %-14s %9.1f MB/s %12.0f rows/s %8.3f s %10ld KiB peak RSS\n",
+                dataset, bench, bytes / best / 1e6, rows / best, best, peakRssKiB());
+    std::fflush(stdout);
+}
+
+void run(const Dataset& d, std::size_t bytes, unsigned threads, int repeat) {
+    std::string data;
+    std::size_t rows = generate(d, bytes, data);
+    CSV::Settings plain;
+    plain.setThreadCount(threads);
+    if (d.crlf)
+        plain.setEnding(CSV::Settings::CRLF);
+    CSV::Settings typed(plain);
+    typed.setAutoDeriveType(true);
+    CSV::Settings view(plain);
+    view.setZeroCopy(true);
+
+    std::size_t sink = 0;
+    measure(d.name, "parse", data.size(), rows, repeat, [&]() {
+        sink += CSV::parse(data, plain).getRowCount();
+    });
+    measure(d.name, "parse-typed", data.size(), rows, repeat, [&]() {
+        sink += CSV::parse(data, typed).getRowCount();
+    });
+    measure(d.name, "parse-view", data.size(), rows, repeat, [&]() {
+        sink += CSV::parse(data, view).getRowCount();
+    });
+
+    CSV table = CSV::parse(data, typed);
+    std::vector<std::string> titles = table.getTitles();
+    std::mt19937_64 rng(7);
+    const std::size_t lookups = std::min<std::size_t>(rows, 1000000);
+    measure(d.name, "access-name", data.size() * lookups / rows, lookups, repeat, [&]() {
+        for (std::size_t i = 0; i < lookups; ++i) {
+            std::size_t row = rng() % rows;
+            const std::string& column = titles[rng() % titles.size()];
+            sink += table.getValue(column, row).has_value();
+        }
+    });
+
+    std::string text;
+    measure(d.name, "write", data.size(), rows, repeat, [&]() {
+        std::ostringstream out;
+        table.write(out);
+        text = out.str();
+    });
+    sink += text.size();
+    if (sink == 0)
+        std::printf("(unexpected empty result)\n");
+}
+
+const char USAGE[] = "usage: csv_bench [--size MB] [--threads N] [--repeat N] [--dataset NAME] [--dump FILE]\n";
+
+} // namespace
+
+int main(int argc, char** argv) {
+    std::size_t size = 64;
+    unsigned threads = 1;
+    int repeat = 3;
+    std::string only;
+    std::string dump;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--help" || arg == "-h") {
+            std::printf("%s", USAGE);
+            return 0;
+        }
+        if (arg != "--size" && arg != "--threads" && arg != "--repeat" && arg != "--dataset" && arg != "--dump") {
+            std::fprintf(stderr, "unknown option %s\n%s", arg.c_str(), USAGE);
+            return 2;
+        }
+        if (i + 1 >= argc) {
+            std::fprintf(stderr, "missing value for %s\n%s", arg.c_str(), USAGE);
+            return 2;
+        }
+        std::string value = argv[++i];
+        if (arg == "--size")
+            size = std::stoul(value);
+        else if (arg == "--threads")
+            threads = static_cast<unsigned>(std::stoul(value));
+        else if (arg == "--repeat")
+            repeat = std::max(1, std::stoi(value));
+        else if (arg == "--dataset")
+            only = value;
+        else
+            dump = value;
+    }
+    if (!dump.empty() && only.empty()) {
+        std::fprintf(stderr, "--dump needs --dataset\n%s", USAGE);
+        return 2;
+    }
+
+    bool found = false;
+    for (const Dataset& d : DATASETS) {
+        if (!only.empty() && only != d.name)
+            continue;
+        found = true;
+        if (!dump.empty()) {
+            std::string data;
+            generate(d, size << 20, data);
+            std::ofstream(dump, std::ios::binary).write(data.data(), static_cast<std::streamsize>(data.size()));
+            return 0;
+        }
+        run(d, size << 20, threads, repeat);
+    }
+    if (!found) {
+        std::fprintf(stderr, "unknown dataset %s\n", only.c_str());
+        return 2;
+    }
+    return 0;
+}
@@ -1,416 +1,5452 @@
-#ifndef CSV_HPP_
-#define CSV_HPP_
-
-#include <algorithm>
-#include <any>
-#include <cstdio>
-#include <exception>
-#include <fstream>
-#include <iostream>
-#include <iomanip>
-#include <sstream>
-#include <stdexcept>
-#include <string>
-#include <utility>
-#include <vector>
-
-namespace tabxx {
-
-class CSV {
-public:
-    class Settings {
-    public:
-        enum LINE_ENDING {LF, CRLF, AUTO};
-
-    public:
-        Settings() : ending_(LF), separator_(','), auto_derive_type_(false), double_precision_(1) {}
-
-        Settings(const Settings& s) : 
-            ending_(s.ending_), 
-            separator_(s.separator_), 
-            auto_derive_type_(s.auto_derive_type_),
-            double_precision_(s.double_precision_) {}
-
-        Settings(Settings&& s) noexcept : Settings(s) {
-
-        }
-
-        Settings& setEnding(LINE_ENDING ending) {
-            ending_ = ending;
-            return *this;
-        }
-
-        LINE_ENDING getEnding() {
-            return ending_;
-        }
-
-        Settings& setSeparator(char separator) {
-            separator_ = separator;
-            return *this;
-        }
-
-        char getSeparator() {
-            return separator_;
-        }
-
-        Settings& setAutoDeriveType(bool opt) {
-            auto_derive_type_ = opt;
-            return *this;
-        }
-
-        Settings& setDoublePrecision(int p) {
-            double_precision_ = p;
-            return *this;
-        }
-
-    private:
-        LINE_ENDING ending_;
-        char separator_;
-        bool auto_derive_type_;
-        int double_precision_;
-        friend class CSV;
-
-    }; // class Settings
-
-    class Line {
-    private:
-        Line() {}
-
-    public:
-        Line(const std::vector<std::any>& v) {
-
-        }
-
-    private:
-
-        std::vector<std::any> data;
-        friend class CSV;
-    
-    }; // class Line
-
-    CSV(const Settings& settings = Settings()) : settings_(settings) {}
-
-    CSV(std::istream& src, const Settings& s = Settings()) : CSV(s) {
-        this->parse(src);
-    }
-
-    CSV(const std::string& str, const Settings& s = Settings()) : CSV(s) {
-        std::istringstream iss(str);
-        this->parse(iss);
-    }
-
-    CSV(const char* str, std::size_t size, const Settings& s = Settings()) : CSV(std::string(str, size), s) {}
-
-    static CSV parse(const std::string& str, const Settings& settings = Settings()) {
-        return CSV(str, settings);
-    }
-
-    static CSV parse(const char* str, std::size_t size, const Settings& settings = Settings()) {
-        return CSV(str, size, settings);
-    }
-
-    std::size_t getColumnCount() {
-        return title_.size();
-    }
-
-    std::size_t getRowCount() {
-        return values_.size();
-    }
-
-    std::vector<std::string> getColumns() {
-        return title_;
-    }
-
-    std::vector<std::any> getRow(std::size_t row) {
-        return values_.at(row);
-    }
-
-    std::vector<std::any> getColumn(std::size_t column) {
-        std::vector<std::any> ret;
-        if (column <= title_.size())
-            for (auto ite : values_)
-                ret.emplace_back(ite.at(column));
-        return ret;
-    }
-
-    std::vector<std::any> getColumn(const std::string& column) {
-        return getColumn(searchTitle(column));
-    }
-
-    std::any& getValue(std::size_t column, std::size_t row) {
-        return values_.at(row).at(column);
-    }
-
-    template <typename V>
-    V getValue(std::size_t column, std::size_t row) {
-        return std::any_cast<V>(getValue(column, row));
-    }
-
-    std::any& getValue(const std::string& column, std::size_t row) {
-        return values_.at(row).at(searchTitle(column));
-    }
-
-    template <typename V>
-    V getValue(const std::string& column, std::size_t row) {
-        return std::any_cast<V>(getValue(column, row));
-    }
-
-    std::vector<std::string> getTitles() {
-        return this->title_;
-    }
-
-    void setTitle(const std::vector<std::string>& t) {
-        clear();
-        title_ = t;
-    }
-
-    void setTitle(std::vector<std::string>&& t) {
-        clear();
-        title_ = std::move(t);
-    }
-
-    void addRow(const std::vector<std::any>& l) {
-        if (l.size() != title_.size())
-            throw std::runtime_error("tabxx::CSV::addRow(): Invalid value count");
-        values_.push_back(l);
-    }
-
-    void addRow(std::vector<std::any>&& l) {
-        if (l.size() != title_.size())
-            throw std::runtime_error("tabxx::CSV::addRow(): Invalid value count");
-        values_.emplace_back(std::move(l));
-    }
-
-    void removeRow(std::size_t index) {
-        if (index >= values_.size())
-            throw std::runtime_error("tabxx::CSV::removeRow(): Index out of range");
-        values_.erase(values_.begin() + index);
-    }
-
-    void removeRow(std::size_t begin, std::size_t end) {
-        if (begin >= values_.size() || end >= values_.size() || begin > end)
-            throw std::runtime_error("tabxx::CSV::removeRow(): Invalid range");
-        values_.erase(values_.begin() + begin, values_.begin() + end);
-    }
-
-    std::size_t searchTitle(const std::string& str) {
-        std::size_t ret = 0;
-        for (; ret < title_.size(); ++ret)
-            if (title_.at(ret) == str)
-                break;
-        return ret;
-    }
-
-    bool empty() {
-        return title_.empty();
-    }
-
-    void clear() {
-        title_.clear();
-        values_.clear();
-    }
-
-    Settings& settings() {
-        return settings_;
-    }
-
-    std::size_t write(std::ostream& des) {
-        std::size_t ret = 0;
-        if (!empty()) {
-            std::size_t lim = title_.size();
-            for (std::size_t i = 0; i < lim; ++i) {
-                des << title_[i];
-                ret += title_[i].size();
-                if (i < (lim - 1)) {
-                    des << settings_.separator_;
-                    ++ ret;
-                }
-            }
-            if (settings_.ending_ == Settings::LF) {
-                des << '\n';
-                ret += 1;
-            }
-            else {
-                des << "\r\n";
-                ret += 2;
-            }
-            lim = values_.size();
-            if (!settings_.auto_derive_type_) {
-                for (std::size_t i = 0; i < lim; ++i) {
-                    auto&& line = values_.at(i);
-                    for (std::size_t j = 0; j < line.size(); ++j) {
-                        auto&& str = std::any_cast<std::string>(line.at(j));
-                        des << str;
-                        ret += str.size();
-                        if (j < line.size() - 1) {
-                            des << settings_.separator_;
-                            ret += 1;
-                        }
-                    }
-                    if (settings_.ending_ == Settings::LF) {
-                        des << '\n';
-                        ret += 1;
-                    }
-                    else {
-                        des << "\r\n";
-                        ret += 2;
-                    }
-                }
-            }
-            else {
-                for (std::size_t i = 0; i < lim; ++i) {
-                    auto&& line = values_.at(i);
-                    for (std::size_t j = 0; j < line.size(); ++j) {
-                        std::string str(anyToString(line[j]));
-                        des << str;
-                        ret += str.size();
-                        if (j < line.size() - 1) {
-                            des << settings_.separator_;
-                            ret += 1;
-                        }
-                    }
-                    if (settings_.ending_ == Settings::LF) {
-                        des << '\n';
-                        ret += 1;
-                    }
-                    else {
-                        des << "\r\n";
-                        ret += 2;
-                    }
-                }
-            }
-        }
-        return ret;
-    }
-
-private:
-    std::any detectType(std::string&& str) {
-        std::any ret;
-        if (str.at(0) == '"' && str.at(str.size() - 1) == '"') {
-            str.erase(str.size() - 1, 1);
-            str.erase(0, 1);
-        }
-        bool isFloat = false;
-        for (auto ch = str.begin(); ch != str.end(); ++ch) { // STRING (std::string)
-            if (!('0' <= *ch && *ch <= '9')) {
-                if (*ch == '.') {
-                    if (!isFloat) {
-                        isFloat = true;
-                        continue;
-                    }
-                    else {
-                        ret = std::move(str);
-                        return ret;
-                    }
-                }
-                else if (ch == str.begin() && (*ch == '+' || *ch == '-'))
-                    continue;
-                ret = std::move(str);
-                return ret;
-            }
-        }
-        if (isFloat) { // FLOAT (double)
-            ret = std::stod(str);
-        }
-        else { // INT (long long)
-            ret = std::stoll(str);
-        }
-        return ret;
-    }
-
-    std::string anyToString(std::any v) {
-        if (v.type() == typeid(std::string))
-            return std::any_cast<std::string>(v);
-        if (v.type() == typeid(double)) {
-            std::stringstream ss;
-            ss << std::fixed << std::setprecision(settings_.double_precision_) << std::any_cast<double>(v);
-            return ss.str();
-        }
-        if (v.type() == typeid(long long))
-            return std::to_string(std::any_cast<long long>(v));
-        if (v.type() == typeid(int))
-            return std::to_string(std::any_cast<int>(v));
-        if (v.type() == typeid(short))
-            return std::to_string(std::any_cast<short>(v));
-        if (v.type() == typeid(char))
-            return std::to_string(std::any_cast<char>(v));
-    }
-
-    int parse(std::istream& src) {
-        std::string line;
-        if (settings_.ending_ == Settings::AUTO) {
-            for (char ch = 0; !src.eof(); ) {
-                ch = src.get();
-                if (ch == '\r') {
-                    settings_.ending_ = Settings::CRLF;
-                    break;
-                }
-                else if (ch == '\n') {
-                    settings_.ending_ = Settings::LF;
-                    break;
-                }
-                else {
-                    line.push_back(ch);
-                }
-            }
-        }
-        char delim_line = (settings_.ending_ == Settings::LF ? '\n' : '\r');
-
-        if (line.empty())
-            return -1;
-        else if (delim_line == '\r')
-            src.get(); // CRLF
-
-        title_.clear();
-        values_.clear();
-        std::stringstream ss(line);
-        for (; ; ) {
-            std::string name;
-            std::getline(ss, name, settings_.separator_);
-            if (!ss.eof() || !name.empty())
-                title_.emplace_back(name);
-            else
-                break;
-        }
-
-        for (; ; ) {
-            std::getline(src, line, delim_line);
-            if (line.empty())
-                if (!src.eof())
-                    throw std::runtime_error("tabxx::CSV::parse(std::istream&): Invalid Dataline (Empty Line)");
-                else
-                    break;
-            if (delim_line == '\r')
-                src.get();
-            std::stringstream s(line);
-            std::vector<std::any> row;
-            for (; ; ) {
-                std::string val;
-                std::getline(s, val, settings_.separator_);
-                if (settings_.auto_derive_type_)
-                    row.emplace_back(detectType(std::move(val)));
-                else
-                    row.emplace_back(std::move(val));
-                if (s.eof())
-                    break;
-            }
-            if (row.size() != getColumnCount())
-                throw std::runtime_error("tabxx::CSV::parse(std::istream&): Invalid Dataline");
-            values_.emplace_back(std::move(row));
-            if (src.eof())
-                break;
-        }
-            
-        return 0;
-    }
-
-private:
-    Settings settings_;
-    std::vector<std::string> title_;
-    std::vector<std::vector<std::any>> values_;
-
-}; // class CSV
-
-} // namespace tabxx
-
-#endif // CSV_HPP_
+#ifndef CSV_HPP_
+#define CSV_HPP_
+
+#include <algorithm>
+#include <any>
+#include <atomic>
+#include <charconv>
+#include <chrono>
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <iomanip>
+#include <iterator>
+#include <limits>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define TABXX_CSV_HAS_MMAP
+#endif
+
+#ifndef TABXX_CSV_NO_SIMD
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define TABXX_CSV_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define TABXX_CSV_SSE2
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define TABXX_CSV_NEON
+#endif
+#endif
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+// Compressed streams need the codec libraries: define TABXX_CSV_ZLIB (link
+// -lz) and/or TABXX_CSV_ZSTD (link -lzstd) before including this header.
+#ifdef TABXX_CSV_ZLIB
+#include <zlib.h>
+#endif
+#ifdef TABXX_CSV_ZSTD
+#include <zstd.h>
+#endif
+
+namespace tabxx {
+
+class CSV {
+public:
+    class RecordView;
+    struct ParseStats;
+
+    class Settings {
+    public:
+        enum LINE_ENDING {LF, CRLF, AUTO};
+        enum COLUMN_TYPE {BOOL, INT32, INT64, DOUBLE, DATE, STRING, DICTIONARY};
+
+    public:
+        Settings() :
+            ending_(LF),
+            separator_(','),
+            auto_derive_type_(false),
+            lazy_(false),
+            double_precision_(1),
+            zero_copy_(false),
+            threads_(1),
+            chunk_size_(8 << 20),
+            prefetch_(0),
+            resource_(nullptr),
+            arena_(false),
+            stats_(nullptr) {}
+
+        Settings(const Settings& s) : 
+            ending_(s.ending_), 
+            separator_(s.separator_), 
+            auto_derive_type_(s.auto_derive_type_),
+            lazy_(s.lazy_),
+            double_precision_(s.double_precision_),
+            zero_copy_(s.zero_copy_),
+            threads_(s.threads_),
+            chunk_size_(s.chunk_size_),
+            prefetch_(s.prefetch_),
+            schema_(s.schema_),
+            selection_(s.selection_),
+            filter_(s.filter_),
+            resource_(s.resource_),
+            arena_(s.arena_),
+            stats_(s.stats_),
+            trace_(s.trace_) {}
+
+        Settings(Settings&& s) noexcept : Settings(s) {
+
+        }
+
+        Settings& setEnding(LINE_ENDING ending) {
+            ending_ = ending;
+            return *this;
+        }
+
+        LINE_ENDING getEnding() {
+            return ending_;
+        }
+
+        Settings& setSeparator(char separator) {
+            separator_ = separator;
+            return *this;
+        }
+
+        char getSeparator() {
+            return separator_;
+        }
+
+        Settings& setAutoDeriveType(bool opt) {
+            auto_derive_type_ = opt;
+            return *this;
+        }
+
+        // Keeps undeclared columns as text and converts a cell on its first
+        // typed read (getValue<double>(), or the derived type for getValue()),
+        // caching the result in the column. Empty fields are null. Takes
+        // precedence over setAutoDeriveType(). Typed reads then update the
+        // cache, so concurrent readers of a table need their own locking.
+        Settings& setLazyConversion(bool opt) {
+            lazy_ = opt;
+            return *this;
+        }
+
+        Settings& setDoublePrecision(int p) {
+            double_precision_ = p;
+            return *this;
+        }
+
+        // String cells become std::string_view into the parsed buffer instead of
+        // owned copies. A caller-provided buffer must outlive the table.
+        Settings& setZeroCopy(bool opt) {
+            zero_copy_ = opt;
+            return *this;
+        }
+
+        // Number of parser threads; 0 uses every hardware thread.
+        Settings& setThreadCount(unsigned n) {
+            threads_ = n;
+            return *this;
+        }
+
+        // Approximate number of input bytes parsed by one task in parallel mode.
+        Settings& setChunkSize(std::size_t bytes) {
+            chunk_size_ = (bytes == 0 ? 1 : bytes);
+            return *this;
+        }
+
+        // Stream input is read on a separate thread up to `blocks` blocks
+        // ahead of the parser; 0 reads inline.
+        Settings& setPrefetch(std::size_t blocks) {
+            prefetch_ = blocks;
+            return *this;
+        }
+
+        // Restricts parsing to the selected columns, kept in input order.
+        // Other fields are skipped without being stored or converted.
+        Settings& selectColumn(const std::string& column) {
+            selection_.push_back(SchemaEntry{column, SIZE_MAX, STRING, true});
+            return *this;
+        }
+
+        Settings& selectColumn(std::size_t column) {
+            selection_.push_back(SchemaEntry{std::string(), column, STRING, true});
+            return *this;
+        }
+
+        Settings& clearSelection() {
+            selection_.clear();
+            return *this;
+        }
+
+        // Column storage allocates from r, which must outlive every table using it.
+        Settings& setMemoryResource(std::pmr::memory_resource* r) {
+            resource_ = r;
+            return *this;
+        }
+
+        // Column storage of each table comes from its own monotonic arena,
+        // released at once by clear() or destruction.
+        Settings& setArena(bool opt) {
+            arena_ = opt;
+            return *this;
+        }
+
+        // Records for which f returns false are dropped before any field is
+        // stored or converted. f may be called concurrently in parallel mode.
+        Settings& setRowFilter(std::function<bool(const RecordView&)> f) {
+            filter_ = std::move(f);
+            return *this;
+        }
+
+        // Parsing accumulates counters and timings into *stats, which must
+        // outlive the parse; nullptr (the default) disables collection.
+        Settings& setStats(ParseStats* stats) {
+            stats_ = stats;
+            return *this;
+        }
+
+        // f is called with the name, start and end of each parse phase
+        // ("csv.parse", "csv.chunk", "csv.read", ...). It may be called
+        // concurrently in parallel mode.
+        Settings& setTraceHook(std::function<void(const char*, std::chrono::steady_clock::time_point,
+                                                  std::chrono::steady_clock::time_point)> f) {
+            trace_ = std::move(f);
+            return *this;
+        }
+
+        // Declares the type of a column so the parser converts it directly
+        // instead of deriving it per cell. Indices refer to input columns.
+        // Later declarations win. DICTIONARY stores text with few distinct
+        // values as integer codes into a dictionary (Column::DICT).
+        Settings& setColumnType(const std::string& column, COLUMN_TYPE type, bool nullable = true) {
+            schema_.push_back(SchemaEntry{column, SIZE_MAX, type, nullable});
+            return *this;
+        }
+
+        Settings& setColumnType(std::size_t column, COLUMN_TYPE type, bool nullable = true) {
+            schema_.push_back(SchemaEntry{std::string(), column, type, nullable});
+            return *this;
+        }
+
+        Settings& clearSchema() {
+            schema_.clear();
+            return *this;
+        }
+
+    private:
+        struct SchemaEntry {
+            std::string name;
+            std::size_t index;
+            COLUMN_TYPE type;
+            bool nullable;
+        };
+
+        unsigned threadCount() const {
+            if (threads_ != 0)
+                return threads_;
+            unsigned n = std::thread::hardware_concurrency();
+            return n == 0 ? 1 : n;
+        }
+
+    private:
+        LINE_ENDING ending_;
+        char separator_;
+        bool auto_derive_type_;
+        bool lazy_;
+        int double_precision_;
+        bool zero_copy_;
+        unsigned threads_;
+        std::size_t chunk_size_;
+        std::size_t prefetch_;
+        std::vector<SchemaEntry> schema_;
+        std::vector<SchemaEntry> selection_;
+        std::function<bool(const RecordView&)> filter_;
+        std::pmr::memory_resource* resource_;
+        bool arena_;
+        ParseStats* stats_;
+        std::function<void(const char*, std::chrono::steady_clock::time_point,
+                           std::chrono::steady_clock::time_point)> trace_;
+        friend class CSV;
+
+    }; // class Settings
+
+    class Line {
+    private:
+        Line() {}
+
+    public:
+        Line(const std::vector<std::any>& v) {
+
+        }
+
+    private:
+
+        std::vector<std::any> data;
+        friend class CSV;
+
+    }; // class Line
+
+private:
+    // Shared ownership of a memory resource that follows the storage using it:
+    // pmr containers keep their resource on move construction only, copies use
+    // the default resource and assignment never changes it.
+    struct ResourceHolder {
+        ResourceHolder() = default;
+        explicit ResourceHolder(std::shared_ptr<std::pmr::memory_resource> r) : ptr(std::move(r)) {}
+        ResourceHolder(const ResourceHolder&) {}
+        ResourceHolder(ResourceHolder&&) = default;
+        ResourceHolder& operator=(const ResourceHolder&) { return *this; }
+        ResourceHolder& operator=(ResourceHolder&&) { return *this; }
+
+        std::shared_ptr<std::pmr::memory_resource> ptr;
+    };
+
+public:
+    // Calendar date, stored in columns as days since 1970-01-01.
+    struct Date {
+        int year;
+        unsigned month;
+        unsigned day;
+
+        long long toDays() const {
+            long long y = year - (month <= 2);
+            long long era = (y >= 0 ? y : y - 399) / 400;
+            long long yoe = y - era * 400;
+            long long doy = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+            long long doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+            return era * 146097 + doe - 719468;
+        }
+
+        static Date fromDays(long long z) {
+            z += 719468;
+            long long era = (z >= 0 ? z : z - 146096) / 146097;
+            long long doe = z - era * 146097;
+            long long yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+            long long doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+            long long mp = (5 * doy + 2) / 153;
+            unsigned d = static_cast<unsigned>(doy - (153 * mp + 2) / 5 + 1);
+            unsigned m = static_cast<unsigned>(mp < 10 ? mp + 3 : mp - 9);
+            return Date{static_cast<int>(yoe + era * 400 + (m <= 2)), m, d};
+        }
+
+        // Parses YYYY-MM-DD.
+        static bool parse(std::string_view str, Date& d) {
+            if (str.size() != 10 || str[4] != '-' || str[7] != '-')
+                return false;
+            const char* p = str.data();
+            if (std::from_chars(p, p + 4, d.year).ptr != p + 4 ||
+                std::from_chars(p + 5, p + 7, d.month).ptr != p + 7 ||
+                std::from_chars(p + 8, p + 10, d.day).ptr != p + 10)
+                return false;
+            return d == fromDays(d.toDays());
+        }
+
+        // Writes YYYY-MM-DD into at least 16 bytes at p and returns the end.
+        char* format(char* p) const {
+            auto pad = [](char* q, unsigned v, int width) {
+                for (int i = width - 1; i >= 0; --i, v /= 10)
+                    q[i] = static_cast<char>('0' + v % 10);
+                return q + width;
+            };
+            if (year < 0 || year > 9999)
+                p = std::to_chars(p, p + 12, year).ptr;
+            else
+                p = pad(p, static_cast<unsigned>(year), 4);
+            *p++ = '-';
+            p = pad(p, month, 2);
+            *p++ = '-';
+            return pad(p, day, 2);
+        }
+
+        bool operator==(const Date& d) const {
+            return year == d.year && month == d.month && day == d.day;
+        }
+
+        bool operator!=(const Date& d) const {
+            return !(*this == d);
+        }
+
+    }; // struct Date
+
+    // Read-only view of contiguous elements owned elsewhere.
+    template <typename T>
+    class ArrayView {
+    public:
+        ArrayView() : data_(nullptr), size_(0) {}
+        ArrayView(const T* data, std::size_t size) : data_(data), size_(size) {}
+
+        const T* data() const {
+            return data_;
+        }
+
+        std::size_t size() const {
+            return size_;
+        }
+
+        bool empty() const {
+            return size_ == 0;
+        }
+
+        const T& operator[](std::size_t i) const {
+            return data_[i];
+        }
+
+        const T* begin() const {
+            return data_;
+        }
+
+        const T* end() const {
+            return data_ + size_;
+        }
+
+    private:
+        const T* data_;
+        std::size_t size_;
+
+    }; // class ArrayView
+
+    // Aggregates of the non-null cells of a numeric column.
+    struct Summary {
+        std::size_t count;
+        double sum;
+        double min; // NaN if count is 0
+        double max;
+
+        double mean() const {
+            return count == 0 ? std::numeric_limits<double>::quiet_NaN() : sum / static_cast<double>(count);
+        }
+
+    }; // struct Summary
+
+    enum AGGREGATE {COUNT, SUM, MINIMUM, MAXIMUM, MEAN};
+
+    // HASH serves findRows(), SORTED serves both findRows() and findRange().
+    enum INDEX {HASH, SORTED};
+
+    class Column {
+    public:
+        // BOOL, INT32, INT and DATE share the same long long storage, which
+        // also holds the codes of DICT (dictionary-encoded text) columns.
+        enum TYPE {NONE, BOOL, INT32, INT, DOUBLE, DATE, STRING, VIEW, ANY, DICT};
+
+    public:
+        Column() : Column(std::pmr::get_default_resource()) {}
+
+        // Storage allocates from r; `keep` (if set) keeps r alive as long as the column uses it.
+        explicit Column(std::pmr::memory_resource* r, std::shared_ptr<std::pmr::memory_resource> keep = nullptr) :
+            resource_(std::move(keep)), type_(NONE), size_(0), reserved_(0), lazy_(false),
+            valid_(r), ints_(r), doubles_(r), spans_(r), blob_(r), views_(r), owned_(r), anys_(r), cache_(r) {}
+
+        TYPE getType() const {
+            return type_;
+        }
+
+        // Text cells of a lazy column convert on typed access (see
+        // Settings::setLazyConversion()).
+        bool isLazy() const {
+            return lazy_;
+        }
+
+        std::size_t size() const {
+            return size_;
+        }
+
+        bool isNull(std::size_t i) const {
+            return !((valid_.at(i >> 6) >> (i & 63)) & 1);
+        }
+
+        long long getInt(std::size_t i) const {
+            return ints_.at(i);
+        }
+
+        double getDouble(std::size_t i) const {
+            return doubles_.at(i);
+        }
+
+        std::string_view getString(std::size_t i) const {
+            if (type_ == DICT)
+                return isNull(i) ? std::string_view() : std::string_view(dict_->values[ints_.at(i)]);
+            if (type_ == VIEW)
+                return views_.at(i);
+            const Span& s = spans_.at(i);
+            return std::string_view(blob_.data() + s.offset, s.length);
+        }
+
+        // Number of null cells in rows [begin, begin + n).
+        std::size_t countNull(std::size_t begin, std::size_t n) const {
+            checkRange(begin, n);
+            std::size_t valid = 0;
+            for (std::size_t i = begin, e = begin + n; i < e; ) {
+                std::size_t bits = std::min<std::size_t>(64 - (i & 63), e - i);
+                std::uint64_t w = valid_[i >> 6] >> (i & 63);
+                if (bits < 64)
+                    w &= (std::uint64_t(1) << bits) - 1;
+                valid += static_cast<std::size_t>(Scanner::popCount(w));
+                i += bits;
+            }
+            return n - valid;
+        }
+
+        // Aggregates rows [begin, begin + n) of a BOOL, INT32, INT, DATE or
+        // DOUBLE column straight from its storage, or of a lazy text column
+        // through the numbers its cells derive to.
+        Summary summarize(std::size_t begin, std::size_t n) const {
+            if (type_ == NONE) { // nothing but nulls
+                checkRange(begin, n);
+                return Summary{0, 0, std::numeric_limits<double>::quiet_NaN(), std::numeric_limits<double>::quiet_NaN()};
+            }
+            if (isDerived())
+                return summarizeDerived(begin, n);
+            if (type_ == DOUBLE)
+                return summarize(slice(doubles_, begin, n).data(), begin, n);
+            return summarize(ints(begin, n).data(), begin, n);
+        }
+
+        Summary summarize() const {
+            return summarize(0, size_);
+        }
+
+        // Native storage of rows [begin, begin + n), without copying; null
+        // cells read as 0 or an empty view. ints() serves BOOL, INT32, INT
+        // and DATE columns, doubles() DOUBLE and views() VIEW columns.
+        ArrayView<long long> ints(std::size_t begin, std::size_t n) const {
+            if (type_ != BOOL && type_ != INT32 && type_ != INT && type_ != DATE)
+                throw std::bad_any_cast();
+            return slice(ints_, begin, n);
+        }
+
+        ArrayView<double> doubles(std::size_t begin, std::size_t n) const {
+            if (type_ != DOUBLE)
+                throw std::bad_any_cast();
+            return slice(doubles_, begin, n);
+        }
+
+        ArrayView<std::string_view> views(std::size_t begin, std::size_t n) const {
+            if (type_ != VIEW)
+                throw std::bad_any_cast();
+            return slice(views_, begin, n);
+        }
+
+        // Codes of rows [begin, begin + n) of a DICT column; null cells read
+        // as 0. Equal codes mean equal text within the column.
+        ArrayView<long long> codes(std::size_t begin, std::size_t n) const {
+            if (type_ != DICT)
+                throw std::bad_any_cast();
+            return slice(ints_, begin, n);
+        }
+
+        // Number of dictionary entries of a DICT column; entries of removed
+        // cells are kept.
+        std::size_t getDictionarySize() const {
+            return dict_ ? dict_->values.size() : 0;
+        }
+
+        std::string_view getDictionaryValue(std::size_t code) const {
+            if (code >= getDictionarySize())
+                throw std::out_of_range("tabxx::CSV::Column::getDictionaryValue(): Code out of range");
+            return dict_->values[code];
+        }
+
+        // Code of v in a DICT column, or -1 if it is not in the dictionary.
+        long long findCode(std::string_view v) const {
+            if (!dict_)
+                return -1;
+            auto ite = dict_->codes.find(v);
+            return ite == dict_->codes.end() ? -1 : ite->second;
+        }
+
+        std::any get(std::size_t i) const {
+            if (i >= size_)
+                throw std::out_of_range("tabxx::CSV::Column::get(): Index out of range");
+            if (isNull(i))
+                return std::any();
+            switch (type_) {
+            case BOOL:
+            case INT32:
+            case INT:
+            case DATE:
+                return box(type_, ints_[i]);
+            case DOUBLE:
+                return doubles_[i];
+            case STRING:
+            case VIEW:
+                if (lazy_) {
+                    const Converted& c = derive(i);
+                    if (c.type == INT)
+                        return c.i;
+                    if (c.type == DOUBLE)
+                        return c.d;
+                }
+                if (type_ == VIEW)
+                    return views_[i];
+                return std::string(getString(i));
+            case DICT:
+                return std::string(getString(i));
+            default:
+                return anys_[i];
+            }
+        }
+
+        // Typed read without boxing into std::any for the column's native type.
+        template <typename V>
+        V get(std::size_t i) const {
+            if (i >= size_)
+                throw std::out_of_range("tabxx::CSV::Column::get(): Index out of range");
+            if (isNull(i))
+                throw std::bad_any_cast();
+            if constexpr (std::is_same_v<V, long long>) {
+                if (type_ == INT || type_ == INT32)
+                    return ints_[i];
+                // Integers widened to DOUBLE, also before a later mismatch
+                // turned the column into ANY, still read back.
+                long long x;
+                if (type_ == DOUBLE && wholeNumber(doubles_[i], x))
+                    return x;
+                if (type_ == ANY && anys_[i].type() == typeid(double) && wholeNumber(std::any_cast<double>(anys_[i]), x))
+                    return x;
+            }
+            else if constexpr (std::is_same_v<V, int>) {
+                if (type_ == INT32)
+                    return static_cast<int>(ints_[i]);
+            }
+            else if constexpr (std::is_same_v<V, bool>) {
+                if (type_ == BOOL)
+                    return ints_[i] != 0;
+            }
+            else if constexpr (std::is_same_v<V, Date>) {
+                if (type_ == DATE)
+                    return Date::fromDays(ints_[i]);
+            }
+            else if constexpr (std::is_same_v<V, double>) {
+                if (type_ == DOUBLE)
+                    return doubles_[i];
+                if (type_ == INT || type_ == INT32)
+                    return static_cast<double>(ints_[i]);
+                if (type_ == ANY && anys_[i].type() == typeid(long long))
+                    return static_cast<double>(std::any_cast<long long>(anys_[i]));
+            }
+            else if constexpr (std::is_same_v<V, std::string_view>) {
+                if (type_ == STRING || type_ == VIEW || type_ == DICT)
+                    return getString(i);
+                if (type_ == ANY && anys_[i].type() == typeid(std::string))
+                    return std::any_cast<const std::string&>(anys_[i]);
+            }
+            else if constexpr (std::is_same_v<V, std::string>) {
+                // Zero-copy cells are views; a std::string read copies them.
+                if (type_ == STRING || type_ == VIEW || type_ == DICT)
+                    return std::string(getString(i));
+                if (type_ == ANY && anys_[i].type() == typeid(std::string_view))
+                    return std::string(std::any_cast<std::string_view>(anys_[i]));
+            }
+            if constexpr (std::is_arithmetic_v<V> || std::is_same_v<V, Date>) {
+                if (lazy_ && (type_ == STRING || type_ == VIEW))
+                    return convert<V>(i);
+            }
+            return std::any_cast<V>(get(i));
+        }
+
+        void pushNull() {
+            switch (type_) {
+            case BOOL:
+            case INT32:
+            case INT:
+            case DATE:
+            case DICT:
+                ints_.push_back(0);
+                break;
+            case DOUBLE:
+                doubles_.push_back(0);
+                break;
+            case STRING:
+                spans_.push_back(Span{0, 0});
+                break;
+            case VIEW:
+                views_.emplace_back();
+                break;
+            case ANY:
+                anys_.emplace_back();
+                break;
+            default:
+                break;
+            }
+            setValid(size_++, false);
+        }
+
+        void pushBool(bool v) {
+            pushInteger(BOOL, v);
+        }
+
+        void pushInt32(int v) {
+            pushInteger(INT32, v);
+        }
+
+        void pushInt(long long v) {
+            pushInteger(INT, v);
+        }
+
+        void pushDate(const Date& v) {
+            pushInteger(DATE, v.toDays());
+        }
+
+        void pushDouble(double v) {
+            if (prepare(DOUBLE))
+                doubles_.push_back(v);
+            else
+                anys_.emplace_back(v);
+            setValid(size_++, true);
+        }
+
+        void pushString(std::string_view v) {
+            if (type_ == DICT)
+                ints_.push_back(encode(v));
+            else if (type_ == VIEW)
+                views_.push_back(own(v));
+            else if (prepare(STRING))
+                spans_.push_back(store(v));
+            else
+                anys_.emplace_back(std::string(v));
+            setValid(size_++, true);
+        }
+
+        // The referenced bytes must outlive the column.
+        void pushView(std::string_view v) {
+            if (type_ == DICT)
+                ints_.push_back(encode(v));
+            else if (prepare(VIEW))
+                views_.push_back(v);
+            else
+                anys_.emplace_back(v);
+            setValid(size_++, true);
+        }
+
+        // Stores v as a code into the column's dictionary, which pays off for
+        // text with few distinct values.
+        void pushEncoded(std::string_view v) {
+            if (prepare(DICT))
+                ints_.push_back(encode(v));
+            else
+                anys_.emplace_back(std::string(v));
+            setValid(size_++, true);
+        }
+
+        void push(const std::any& v) {
+            TYPE t = typeOf(v);
+            switch (t) {
+            case NONE:
+                pushNull();
+                break;
+            case BOOL:
+            case INT32:
+            case INT:
+            case DATE:
+                pushInteger(t, integerOf(t, v));
+                break;
+            case DOUBLE:
+                pushDouble(std::any_cast<double>(v));
+                break;
+            case STRING:
+                pushString(std::any_cast<const std::string&>(v));
+                break;
+            case VIEW:
+                pushView(std::any_cast<std::string_view>(v));
+                break;
+            default:
+                prepare(ANY);
+                anys_.push_back(v);
+                setValid(size_++, true);
+                break;
+            }
+        }
+
+        void set(std::size_t i, const std::any& v) {
+            if (i >= size_)
+                throw std::out_of_range("tabxx::CSV::Column::set(): Index out of range");
+            if (i < cache_.size())
+                cache_[i].type = cache_[i].cast = NONE;
+            TYPE t = typeOf(v);
+            if (t == NONE) {
+                switch (type_) {
+                case BOOL: case INT32: case INT: case DATE: case DICT: ints_[i] = 0; break;
+                case DOUBLE: doubles_[i] = 0; break;
+                case STRING: spans_[i] = Span{0, 0}; break;
+                case VIEW: views_[i] = std::string_view(); break;
+                case ANY: anys_[i].reset(); break;
+                default: break;
+                }
+                setValid(i, false);
+                return;
+            }
+            if (type_ == DICT && (t == STRING || t == VIEW))
+                ints_[i] = encode(t == STRING ? std::string_view(std::any_cast<const std::string&>(v)) :
+                                                std::any_cast<std::string_view>(v));
+            else if (t == STRING && type_ == VIEW)
+                views_[i] = own(std::any_cast<const std::string&>(v));
+            else if (!prepare(t) || t == ANY)
+                anys_[i] = v;
+            else if (type_ == DOUBLE)
+                doubles_[i] = t == DOUBLE ? std::any_cast<double>(v) : static_cast<double>(integerOf(t, v));
+            else if (t == STRING)
+                spans_[i] = store(std::any_cast<const std::string&>(v));
+            else if (t == VIEW)
+                views_[i] = std::any_cast<std::string_view>(v);
+            else
+                ints_[i] = integerOf(t, v);
+            setValid(i, true);
+        }
+
+        void erase(std::size_t begin, std::size_t end) {
+            if (begin > end || end > size_)
+                throw std::out_of_range("tabxx::CSV::Column::erase(): Invalid range");
+            switch (type_) {
+            case BOOL: case INT32: case INT: case DATE: case DICT: ints_.erase(ints_.begin() + begin, ints_.begin() + end); break;
+            case DOUBLE: doubles_.erase(doubles_.begin() + begin, doubles_.begin() + end); break;
+            case STRING: spans_.erase(spans_.begin() + begin, spans_.begin() + end); break;
+            case VIEW: views_.erase(views_.begin() + begin, views_.begin() + end); break;
+            case ANY: anys_.erase(anys_.begin() + begin, anys_.begin() + end); break;
+            default: break;
+            }
+            cache_.clear();
+            std::size_t n = end - begin;
+            for (std::size_t i = begin; i + n < size_; ++i)
+                setValid(i, !isNull(i + n));
+            size_ -= n;
+            valid_.resize((size_ + 63) >> 6);
+        }
+
+        // Removes every row i with mask[i] set, keeping the order of the rest.
+        void erase(const std::vector<bool>& mask) {
+            switch (type_) {
+            case BOOL: case INT32: case INT: case DATE: case DICT: compact(ints_, mask); break;
+            case DOUBLE: compact(doubles_, mask); break;
+            case STRING: compact(spans_, mask); break;
+            case VIEW: compact(views_, mask); break;
+            case ANY: compact(anys_, mask); break;
+            default: break;
+            }
+            cache_.clear();
+            std::size_t w = 0;
+            for (std::size_t r = 0; r < size_; ++r)
+                if (r >= mask.size() || !mask[r])
+                    setValid(w++, !isNull(r));
+            size_ = w;
+            valid_.resize((size_ + 63) >> 6);
+        }
+
+        void append(Column&& other) {
+            if (type_ == NONE && size_ == 0 && ints_.get_allocator() == other.ints_.get_allocator()) {
+                *this = std::move(other);
+                return;
+            }
+            lazy_ = lazy_ || other.lazy_;
+            if (isNumeric(type_) && isNumeric(other.type_)) {
+                prepare(other.type_);
+                other.prepare(type_);
+            }
+            if (other.type_ != NONE && type_ != NONE && other.type_ != type_) {
+                for (std::size_t i = 0; i < other.size_; ++i)
+                    push(other.get(i));
+                // The pushed views may point into other's owned strings.
+                owned_.insert(owned_.end(), other.owned_.begin(), other.owned_.end());
+                return;
+            }
+            if (other.type_ == NONE) {
+                for (std::size_t i = 0; i < other.size_; ++i)
+                    pushNull();
+                return;
+            }
+            prepare(other.type_);
+            switch (type_) {
+            case BOOL:
+            case INT32:
+            case INT:
+            case DATE:
+                ints_.insert(ints_.end(), other.ints_.begin(), other.ints_.end());
+                break;
+            case DOUBLE:
+                doubles_.insert(doubles_.end(), other.doubles_.begin(), other.doubles_.end());
+                break;
+            case STRING: {
+                std::size_t base = blob_.size();
+                blob_.append(other.blob_);
+                spans_.reserve(spans_.size() + other.spans_.size());
+                for (auto&& sp : other.spans_)
+                    spans_.push_back(Span{sp.offset + base, sp.length});
+                break;
+            }
+            case VIEW:
+                views_.insert(views_.end(), other.views_.begin(), other.views_.end());
+                owned_.insert(owned_.end(), other.owned_.begin(), other.owned_.end());
+                break;
+            case DICT:
+                if (!dict_ || dict_ == other.dict_) {
+                    dict_ = other.dict_;
+                    ints_.insert(ints_.end(), other.ints_.begin(), other.ints_.end());
+                }
+                else {
+                    // Recode into this dictionary, looking each entry up once.
+                    std::vector<long long> recode(other.getDictionarySize(), -1);
+                    ints_.reserve(ints_.size() + other.ints_.size());
+                    for (std::size_t i = 0; i < other.size_; ++i) {
+                        if (other.isNull(i)) {
+                            ints_.push_back(0);
+                            continue;
+                        }
+                        long long& c = recode[other.ints_[i]];
+                        if (c < 0)
+                            c = encode(other.dict_->values[other.ints_[i]]);
+                        ints_.push_back(c);
+                    }
+                }
+                break;
+            default:
+                anys_.insert(anys_.end(), std::make_move_iterator(other.anys_.begin()), std::make_move_iterator(other.anys_.end()));
+                break;
+            }
+            for (std::size_t i = 0; i < other.size_; ++i)
+                setValid(size_ + i, !other.isNull(i));
+            size_ += other.size_;
+            other.clear();
+        }
+
+        // Makes room for n cells without reallocating; a column that holds no
+        // values yet applies it once its type is known.
+        void reserve(std::size_t n) {
+            reserved_ = n;
+            valid_.reserve((n + 63) >> 6);
+            switch (type_) {
+            case BOOL: case INT32: case INT: case DATE: case DICT: ints_.reserve(n); break;
+            case DOUBLE: doubles_.reserve(n); break;
+            case STRING: spans_.reserve(n); break;
+            case VIEW: views_.reserve(n); break;
+            case ANY: anys_.reserve(n); break;
+            default: break;
+            }
+        }
+
+        // Keeps the first n cells; the storage of the rest is not released.
+        void truncate(std::size_t n) {
+            if (n >= size_)
+                return;
+            switch (type_) {
+            case BOOL: case INT32: case INT: case DATE: case DICT: ints_.resize(n); break;
+            case DOUBLE: doubles_.resize(n); break;
+            case STRING: spans_.resize(n); break;
+            case VIEW: views_.resize(n); break;
+            case ANY: anys_.resize(n); break;
+            default: break;
+            }
+            if (cache_.size() > n)
+                cache_.resize(n);
+            size_ = n;
+            valid_.resize((size_ + 63) >> 6);
+            if (size_ & 63)
+                valid_.back() &= (std::uint64_t(1) << (size_ & 63)) - 1;
+        }
+
+        void clear() {
+            type_ = NONE;
+            size_ = 0;
+            reserved_ = 0;
+            lazy_ = false;
+            cache_.clear();
+            valid_.clear();
+            ints_.clear();
+            doubles_.clear();
+            spans_.clear();
+            blob_.clear();
+            views_.clear();
+            owned_.clear();
+            anys_.clear();
+            dict_.reset();
+        }
+
+        // Like clear(), but a DICT column keeps its dictionary, so refilling
+        // it with the same values does not rebuild it.
+        void reset() {
+            std::shared_ptr<Dictionary> dict = std::move(dict_);
+            clear();
+            dict_ = std::move(dict);
+        }
+
+    private:
+        struct Span {
+            std::size_t offset;
+            std::size_t length;
+        };
+
+        struct Chunk {
+            explicit Chunk(std::size_t n) : data(new char[n]), size(0), capacity(n) {}
+
+            std::unique_ptr<char[]> data;
+            std::size_t size;
+            std::size_t capacity;
+        };
+
+        // Distinct values of a DICT column, indexed by code. Copies of a
+        // column share it until one of them adds an entry.
+        struct Dictionary {
+            std::deque<std::string> values; // stable addresses for the keys below
+            std::unordered_map<std::string_view, long long> codes;
+        };
+
+        // Memoized conversions of a lazy text cell: `type` is what
+        // auto-derivation gives (NONE if not derived yet, STRING if the text is
+        // not a number), `cast` the last BOOL or DATE read of the cell.
+        struct Converted {
+            TYPE type;
+            TYPE cast;
+            union {
+                long long i;
+                double d;
+            };
+            long long value; // of `cast`
+        };
+
+        // Cells are typed through derive() rather than by the storage.
+        bool isDerived() const {
+            return lazy_ && (type_ == STRING || type_ == VIEW);
+        }
+
+        // Throws std::bad_any_cast for a cell that is not a number.
+        Summary summarizeDerived(std::size_t begin, std::size_t n) const {
+            checkRange(begin, n);
+            Summary s{0, 0, std::numeric_limits<double>::quiet_NaN(), std::numeric_limits<double>::quiet_NaN()};
+            for (std::size_t i = begin; i < begin + n; ++i) {
+                if (isNull(i))
+                    continue;
+                const Converted& c = derive(i);
+                if (c.type != INT && c.type != DOUBLE)
+                    throw std::bad_any_cast();
+                double x = c.type == INT ? static_cast<double>(c.i) : c.d;
+                s.sum += x;
+                s.min = s.count == 0 ? x : std::min(s.min, x);
+                s.max = s.count == 0 ? x : std::max(s.max, x);
+                ++s.count;
+            }
+            return s;
+        }
+
+        Converted& cached(std::size_t i) const {
+            if (cache_.size() < size_)
+                cache_.resize(size_, Converted{NONE, NONE, {0}, 0});
+            return cache_[i];
+        }
+
+        // The type auto-derivation would have given the cell.
+        const Converted& derive(std::size_t i) const {
+            Converted& c = cached(i);
+            if (c.type == NONE) {
+                std::string_view v = getString(i);
+                const char* b = v.data();
+                const char* e = b + v.size();
+                long long x;
+                double d;
+                if (parseInt(b, e, x)) {
+                    c.type = INT;
+                    c.i = x;
+                }
+                else if (parseDouble(b, e, d)) {
+                    c.type = DOUBLE;
+                    c.d = d;
+                }
+                else
+                    c.type = STRING;
+            }
+            return c;
+        }
+
+        // Converts the text of cell i to V; throws std::bad_any_cast if the
+        // text is not a V. Numbers come from derive(), so typed reads never
+        // change what get(i) returns.
+        template <typename V>
+        V convert(std::size_t i) const {
+            if constexpr (std::is_same_v<V, bool> || std::is_same_v<V, Date>) {
+                Converted& c = cached(i);
+                constexpr TYPE t = std::is_same_v<V, bool> ? BOOL : DATE;
+                if (c.cast != t) {
+                    std::string_view v = getString(i);
+                    if constexpr (t == BOOL) {
+                        bool x;
+                        if (!parseBool(v, x))
+                            throw std::bad_any_cast();
+                        c.value = x;
+                    }
+                    else {
+                        Date x{};
+                        if (!Date::parse(v, x))
+                            throw std::bad_any_cast();
+                        c.value = x.toDays();
+                    }
+                    c.cast = t;
+                }
+                if constexpr (t == BOOL)
+                    return c.value != 0;
+                else
+                    return Date::fromDays(c.value);
+            }
+            else {
+                const Converted& c = derive(i);
+                if constexpr (std::is_integral_v<V>) {
+                    if (c.type != INT ||
+                        c.i < static_cast<long long>(std::numeric_limits<V>::min()) ||
+                        (c.i > 0 && static_cast<unsigned long long>(c.i) > static_cast<unsigned long long>(std::numeric_limits<V>::max())))
+                        throw std::bad_any_cast();
+                    return static_cast<V>(c.i);
+                }
+                else {
+                    if (c.type == INT)
+                        return static_cast<V>(c.i);
+                    if (c.type != DOUBLE)
+                        throw std::bad_any_cast();
+                    return static_cast<V>(c.d);
+                }
+            }
+        }
+
+        template <typename V>
+        static void compact(V& v, const std::vector<bool>& mask) {
+            std::size_t w = 0;
+            for (std::size_t r = 0; r < v.size(); ++r) {
+                if (r < mask.size() && mask[r])
+                    continue;
+                if (w != r)
+                    v[w] = std::move(v[r]);
+                ++w;
+            }
+            v.erase(v.begin() + w, v.end());
+        }
+
+        static TYPE typeOf(const std::any& v) {
+            if (!v.has_value())
+                return NONE;
+            const std::type_info& t = v.type();
+            if (t == typeid(long long))
+                return INT;
+            if (t == typeid(double))
+                return DOUBLE;
+            if (t == typeid(std::string))
+                return STRING;
+            if (t == typeid(std::string_view))
+                return VIEW;
+            if (t == typeid(int))
+                return INT32;
+            if (t == typeid(bool))
+                return BOOL;
+            if (t == typeid(Date))
+                return DATE;
+            return ANY;
+        }
+
+        static long long integerOf(TYPE t, const std::any& v) {
+            switch (t) {
+            case BOOL: return std::any_cast<bool>(v);
+            case INT32: return std::any_cast<int>(v);
+            case DATE: return std::any_cast<const Date&>(v).toDays();
+            default: return std::any_cast<long long>(v);
+            }
+        }
+
+        static std::any box(TYPE t, long long v) {
+            switch (t) {
+            case BOOL: return v != 0;
+            case INT32: return static_cast<int>(v);
+            case DATE: return Date::fromDays(v);
+            default: return v;
+            }
+        }
+
+        void pushInteger(TYPE t, long long v) {
+            if (!prepare(t))
+                anys_.push_back(box(t, v));
+            else if (type_ == DOUBLE)
+                doubles_.push_back(static_cast<double>(v));
+            else
+                ints_.push_back(v);
+            setValid(size_++, true);
+        }
+
+        // v points at row `begin`. Runs of 64 valid cells take a branch-free
+        // loop the compiler can vectorize; other runs visit the set bits only.
+        template <typename T>
+        Summary summarize(const T* v, std::size_t begin, std::size_t n) const {
+            Summary s{0, 0, std::numeric_limits<double>::quiet_NaN(), std::numeric_limits<double>::quiet_NaN()};
+            T lo = std::numeric_limits<T>::max();
+            T hi = std::numeric_limits<T>::lowest();
+            v -= begin;
+            for (std::size_t i = begin, e = begin + n; i < e; ) {
+                std::size_t bits = std::min<std::size_t>(64 - (i & 63), e - i);
+                std::uint64_t mask = bits < 64 ? (std::uint64_t(1) << bits) - 1 : ~std::uint64_t(0);
+                std::uint64_t w = (valid_[i >> 6] >> (i & 63)) & mask;
+                T sum = 0;
+                if (w == mask) {
+                    for (std::size_t k = i; k < i + bits; ++k) {
+                        sum += v[k];
+                        lo = std::min(lo, v[k]);
+                        hi = std::max(hi, v[k]);
+                    }
+                    s.count += bits;
+                }
+                else {
+                    for (; w != 0; w &= w - 1) {
+                        T x = v[i + Scanner::trailingZeros(w)];
+                        sum += x;
+                        lo = std::min(lo, x);
+                        hi = std::max(hi, x);
+                        ++s.count;
+                    }
+                }
+                s.sum += static_cast<double>(sum);
+                i += bits;
+            }
+            if (s.count != 0) {
+                s.min = static_cast<double>(lo);
+                s.max = static_cast<double>(hi);
+            }
+            return s;
+        }
+
+        void checkRange(std::size_t begin, std::size_t n) const {
+            if (begin > size_ || n > size_ - begin)
+                throw std::out_of_range("tabxx::CSV::Column::slice(): Invalid range");
+        }
+
+        template <typename V>
+        ArrayView<typename V::value_type> slice(const V& v, std::size_t begin, std::size_t n) const {
+            checkRange(begin, n);
+            return ArrayView<typename V::value_type>(v.data() + begin, n);
+        }
+
+        Span store(std::string_view v) {
+            Span s{blob_.size(), v.size()};
+            blob_.append(v.data(), v.size());
+            return s;
+        }
+
+        long long encode(std::string_view v) {
+            if (dict_) {
+                auto ite = dict_->codes.find(v);
+                if (ite != dict_->codes.end())
+                    return ite->second;
+            }
+            if (!dict_ || dict_.use_count() > 1) {
+                auto d = std::make_shared<Dictionary>();
+                if (dict_) {
+                    d->values = dict_->values;
+                    for (std::size_t c = 0; c < d->values.size(); ++c)
+                        d->codes.emplace(d->values[c], static_cast<long long>(c));
+                }
+                dict_ = std::move(d);
+            }
+            long long c = static_cast<long long>(dict_->values.size());
+            dict_->values.emplace_back(v);
+            dict_->codes.emplace(dict_->values.back(), c);
+            return c;
+        }
+
+        // Strings added to a VIEW column have no external owner; they are
+        // copied into chunks that never move. Copies of the column share the
+        // chunks, so only an unshared last chunk is filled further.
+        std::string_view own(std::string_view v) {
+            Chunk* c = owned_.empty() || owned_.back().use_count() > 1 ? nullptr : owned_.back().get();
+            if (c == nullptr || c->capacity - c->size < v.size()) {
+                std::size_t n = std::min<std::size_t>(c == nullptr ? 256 : 2 * c->capacity, 1 << 16);
+                owned_.push_back(std::make_shared<Chunk>(std::max(n, v.size())));
+                c = owned_.back().get();
+            }
+            char* p = c->data.get() + c->size;
+            std::memcpy(p, v.data(), v.size());
+            c->size += v.size();
+            return std::string_view(p, v.size());
+        }
+
+        void setValid(std::size_t i, bool v) {
+            if ((i >> 6) >= valid_.size())
+                valid_.resize((i >> 6) + 1, 0);
+            if (v)
+                valid_[i >> 6] |= (std::uint64_t(1) << (i & 63));
+            else
+                valid_[i >> 6] &= ~(std::uint64_t(1) << (i & 63));
+        }
+
+        static bool isNumeric(TYPE t) {
+            return t == INT32 || t == INT || t == DOUBLE;
+        }
+
+        static bool wholeNumber(double d, long long& out) {
+            if (d != std::trunc(d) || !(std::abs(d) < 0x1p63))
+                return false;
+            out = static_cast<long long>(d);
+            return true;
+        }
+
+        // Makes the column able to hold a value of type t; returns false if it
+        // had to fall back to ANY storage because of a type mismatch. Mixed
+        // numbers widen the column instead (INT32 to INT, integers to DOUBLE),
+        // so type_ may differ from t after a successful call.
+        bool prepare(TYPE t) {
+            if (type_ == t)
+                return true;
+            if (isNumeric(type_) && isNumeric(t)) {
+                TYPE w = type_ == DOUBLE || t == DOUBLE ? DOUBLE : INT;
+                if (w == DOUBLE && type_ != DOUBLE) {
+                    doubles_.reserve(std::max(reserved_, size_));
+                    for (long long v : ints_)
+                        doubles_.push_back(static_cast<double>(v));
+                    ints_.clear();
+                    ints_.shrink_to_fit();
+                }
+                type_ = w;
+                return true;
+            }
+            if (type_ == NONE) {
+                type_ = t;
+                switch (t) {
+                case BOOL: case INT32: case INT: case DATE: case DICT: ints_.reserve(reserved_); ints_.resize(size_, 0); break;
+                case DOUBLE: doubles_.reserve(reserved_); doubles_.resize(size_, 0); break;
+                case STRING: spans_.reserve(reserved_); spans_.resize(size_, Span{0, 0}); break;
+                case VIEW: views_.reserve(reserved_); views_.resize(size_); break;
+                default: anys_.reserve(reserved_); anys_.resize(size_); break;
+                }
+                return true;
+            }
+            if (type_ != ANY) {
+                std::pmr::vector<std::any> a(anys_.get_allocator());
+                a.reserve(size_);
+                for (std::size_t i = 0; i < size_; ++i)
+                    a.emplace_back(get(i));
+                ints_.clear();
+                ints_.shrink_to_fit();
+                doubles_.clear();
+                doubles_.shrink_to_fit();
+                spans_.clear();
+                spans_.shrink_to_fit();
+                blob_.clear();
+                blob_.shrink_to_fit();
+                views_.clear();
+                views_.shrink_to_fit();
+                dict_.reset();
+                cache_.clear();
+                anys_ = std::move(a);
+                type_ = ANY;
+            }
+            return t == ANY;
+        }
+
+    private:
+        ResourceHolder resource_; // destroyed after the storage below
+        TYPE type_;
+        std::size_t size_;
+        std::size_t reserved_;
+        bool lazy_;
+        std::pmr::vector<std::uint64_t> valid_;
+        std::pmr::vector<long long> ints_;
+        std::pmr::vector<double> doubles_;
+        std::pmr::vector<Span> spans_;
+        std::pmr::string blob_;
+        std::pmr::vector<std::string_view> views_;
+        std::pmr::vector<std::shared_ptr<Chunk>> owned_;
+        std::pmr::vector<std::any> anys_;
+        mutable std::pmr::vector<Converted> cache_;
+        std::shared_ptr<Dictionary> dict_;
+        friend class CSV;
+
+    }; // class Column
+
+    // Counters filled in by a parse when set through Settings::setStats().
+    // Times are in nanoseconds and are summed over threads in parallel mode.
+    // Allocations can be counted by a memory resource given to
+    // Settings::setMemoryResource().
+    struct ParseStats {
+        std::uint64_t bytes;      // data bytes consumed, after the title line
+        std::uint64_t rows;       // records stored
+        std::uint64_t filtered;   // records dropped by the row filter
+        std::uint64_t fields;     // fields tokenized, including skipped ones
+        std::uint64_t io_ns;      // reading the input
+        std::uint64_t tokenize_ns; // scanning for separators, quotes and line ends
+        std::uint64_t convert_ns; // storing and converting fields
+        std::uint64_t merge_ns;   // joining the chunks of a parallel parse
+        // types[c][t]: cells of column c derived as Column::TYPE t with
+        // Settings::setAutoDeriveType().
+        std::vector<std::vector<std::uint64_t>> types;
+
+        ParseStats() {
+            clear();
+        }
+
+        void clear() {
+            bytes = rows = filtered = fields = 0;
+            io_ns = tokenize_ns = convert_ns = merge_ns = 0;
+            types.clear();
+        }
+
+        void merge(const ParseStats& s) {
+            bytes += s.bytes;
+            rows += s.rows;
+            filtered += s.filtered;
+            fields += s.fields;
+            io_ns += s.io_ns;
+            tokenize_ns += s.tokenize_ns;
+            convert_ns += s.convert_ns;
+            merge_ns += s.merge_ns;
+            if (types.size() < s.types.size())
+                types.resize(s.types.size(), std::vector<std::uint64_t>(Column::ANY + 1));
+            for (std::size_t c = 0; c < s.types.size(); ++c)
+                for (std::size_t t = 0; t < s.types[c].size(); ++t)
+                    types[c][t] += s.types[c][t];
+        }
+
+    }; // struct ParseStats
+
+    // A column resolved by name once; stays valid until the table's titles change.
+    class ColumnHandle {
+    public:
+        std::size_t getIndex() const {
+            return index_;
+        }
+
+        const Column& getColumnData() const {
+            return table_->columns_[index_];
+        }
+
+        std::any get(std::size_t row) const {
+            return table_->columns_[index_].get(row);
+        }
+
+        template <typename V>
+        V get(std::size_t row) const {
+            return table_->columns_[index_].template get<V>(row);
+        }
+
+    private:
+        ColumnHandle(CSV* table, std::size_t index) : table_(table), index_(index) {}
+
+    private:
+        CSV* table_;
+        std::size_t index_;
+        friend class CSV;
+
+    }; // class ColumnHandle
+
+    // Rows [getBegin(), getBegin() + size()) of a table, exposing each column's
+    // native storage as contiguous arrays for tight loops. Valid until the table
+    // is modified.
+    class RowBlock {
+    public:
+        std::size_t getBegin() const {
+            return begin_;
+        }
+
+        std::size_t size() const {
+            return size_;
+        }
+
+        std::size_t getColumnCount() const {
+            return table_->columns_.size();
+        }
+
+        const Column& getColumnData(std::size_t column) const {
+            return table_->columns_.at(column);
+        }
+
+        // `row` is relative to the block.
+        bool isNull(std::size_t column, std::size_t row) const {
+            return getColumnData(column).isNull(begin_ + row);
+        }
+
+        std::size_t countNull(std::size_t column) const {
+            return getColumnData(column).countNull(begin_, size_);
+        }
+
+        Summary summarize(std::size_t column) const {
+            return getColumnData(column).summarize(begin_, size_);
+        }
+
+        ArrayView<long long> ints(std::size_t column) const {
+            return getColumnData(column).ints(begin_, size_);
+        }
+
+        ArrayView<double> doubles(std::size_t column) const {
+            return getColumnData(column).doubles(begin_, size_);
+        }
+
+        ArrayView<std::string_view> views(std::size_t column) const {
+            return getColumnData(column).views(begin_, size_);
+        }
+
+    private:
+        RowBlock(const CSV* table, std::size_t begin, std::size_t size) : table_(table), begin_(begin), size_(size) {}
+
+        const CSV* table_;
+        std::size_t begin_;
+        std::size_t size_;
+        friend class CSV;
+
+    }; // class RowBlock
+
+    // Raw fields of a record that is being parsed, indexed like the input columns
+    // (including those not kept by Settings::selectColumn()).
+    class RecordView {
+    public:
+        std::size_t size() const {
+            return fields_->size();
+        }
+
+        std::string_view operator[](std::size_t column) const {
+            return (*fields_)[column];
+        }
+
+        std::string_view at(std::size_t column) const {
+            if (column >= size())
+                throw std::out_of_range("tabxx::CSV::RecordView::at(): Index out of range");
+            return (*this)[column];
+        }
+
+        std::string_view at(const std::string& column) const {
+            return (*this)[table_->searchInput(column)];
+        }
+
+        // Converts a field to long long, int, double, bool, Date, std::string or std::string_view.
+        template <typename V>
+        V as(std::size_t column) const {
+            std::string_view v = at(column);
+            if constexpr (std::is_same_v<V, std::string_view>)
+                return v;
+            else if constexpr (std::is_same_v<V, std::string>)
+                return std::string(v);
+            else {
+                V ret;
+                bool ok;
+                if constexpr (std::is_same_v<V, bool>)
+                    ok = parseBool(v, ret);
+                else if constexpr (std::is_same_v<V, Date>)
+                    ok = Date::parse(v, ret);
+                else if constexpr (std::is_floating_point_v<V>)
+                    ok = parseDouble(v.data(), v.data() + v.size(), ret);
+                else
+                    ok = parseInt(v.data(), v.data() + v.size(), ret);
+                if (!ok)
+                    throw std::runtime_error("tabxx::CSV::RecordView::as(): Cannot convert \"" + std::string(v) + "\"");
+                return ret;
+            }
+        }
+
+        template <typename V>
+        V as(const std::string& column) const {
+            return as<V>(table_->searchInput(column));
+        }
+
+    private:
+        RecordView(CSV* table, const std::vector<std::string_view>* fields) : table_(table), fields_(fields) {}
+
+    private:
+        CSV* table_;
+        const std::vector<std::string_view>* fields_;
+        friend class CSV;
+
+    }; // class RecordView
+
+    // Members of Row bound to columns by name or input index, declared once:
+    //     CSV::RowMapping<Trade> m;
+    //     m.bind("price", &Trade::price).bind("qty", &Trade::qty);
+    // Members may be arithmetic, Date, std::string or std::string_view; null
+    // cells leave them value-initialized.
+    template <typename Row>
+    class RowMapping {
+    public:
+        template <typename V>
+        RowMapping& bind(const std::string& column, V Row::* member) {
+            return add(column, SIZE_MAX, member);
+        }
+
+        template <typename V>
+        RowMapping& bind(std::size_t column, V Row::* member) {
+            return add(std::string(), column, member);
+        }
+
+        std::size_t size() const {
+            return bindings_.size();
+        }
+
+    private:
+        struct Binding {
+            std::string name;
+            std::size_t index;
+            std::function<bool(Row&, std::string_view)> field;
+            std::function<void(Row&, const Column&, std::size_t)> cell;
+        };
+
+        template <typename V>
+        RowMapping& add(std::string name, std::size_t index, V Row::* member) {
+            static_assert(std::is_arithmetic_v<V> || std::is_same_v<V, Date> ||
+                          std::is_same_v<V, std::string> || std::is_same_v<V, std::string_view>,
+                          "tabxx::CSV::RowMapping: Unsupported member type");
+            bindings_.push_back(Binding{std::move(name), index,
+                [member](Row& row, std::string_view v) { return readField(v, row.*member); },
+                [member](Row& row, const Column& c, std::size_t i) { readCell(c, i, row.*member); }});
+            return *this;
+        }
+
+    private:
+        std::vector<Binding> bindings_;
+        friend class CSV;
+
+    }; // class RowMapping
+
+    class MappedFile {
+    public:
+        explicit MappedFile(const std::string& path) : data_(nullptr), size_(0) {
+#ifdef TABXX_CSV_HAS_MMAP
+            int fd = ::open(path.c_str(), O_RDONLY);
+            if (fd < 0)
+                throw std::runtime_error("tabxx::CSV::MappedFile::MappedFile(): Cannot open " + path);
+            struct stat st;
+            if (::fstat(fd, &st) != 0) {
+                ::close(fd);
+                throw std::runtime_error("tabxx::CSV::MappedFile::MappedFile(): Cannot stat " + path);
+            }
+            size_ = static_cast<std::size_t>(st.st_size);
+            if (size_ > 0) {
+                void* p = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+                if (p == MAP_FAILED) {
+                    ::close(fd);
+                    throw std::runtime_error("tabxx::CSV::MappedFile::MappedFile(): Cannot map " + path);
+                }
+                ::madvise(p, size_, MADV_SEQUENTIAL);
+                data_ = static_cast<const char*>(p);
+            }
+            ::close(fd);
+#else
+            std::ifstream ifs(path, std::ios::binary);
+            if (!ifs)
+                throw std::runtime_error("tabxx::CSV::MappedFile::MappedFile(): Cannot open " + path);
+            buffer_.assign(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+            data_ = buffer_.data();
+            size_ = buffer_.size();
+#endif
+        }
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        ~MappedFile() {
+#ifdef TABXX_CSV_HAS_MMAP
+            if (data_ != nullptr)
+                ::munmap(const_cast<char*>(data_), size_);
+#endif
+        }
+
+        const char* data() const {
+            return data_;
+        }
+
+        std::size_t size() const {
+            return size_;
+        }
+
+    private:
+        const char* data_;
+        std::size_t size_;
+#ifndef TABXX_CSV_HAS_MMAP
+        std::string buffer_;
+#endif
+
+    }; // class MappedFile
+
+    // Classifies 64 input bytes at a time into bitmaps of structural characters.
+    class Scanner {
+    public:
+        static constexpr std::size_t BLOCK_SIZE = 64;
+        static constexpr std::uint64_t FIELD_START = 1; // carry of fieldQuoteMask() at a record start
+
+        struct Block {
+            std::uint64_t separator;
+            std::uint64_t quote;
+            std::uint64_t ending;
+        };
+
+    public:
+        Scanner(char separator, char ending, char ending2) :
+            separator_(separator), ending_(ending), ending2_(ending2), crlf_(ending == '\r' && ending2 == '\r') {}
+
+        Block scan(const char* p) const {
+            Block b;
+            b.separator = match(p, separator_);
+            b.quote = match(p, '"');
+            b.ending = match(p, ending_);
+            if (ending2_ != ending_)
+                b.ending |= match(p, ending2_);
+            return b;
+        }
+
+        Block scan(const char* p, std::size_t n) const {
+            if (n >= BLOCK_SIZE)
+                return scan(p);
+            alignas(64) char buf[BLOCK_SIZE] = {};
+            std::memcpy(buf, p, n);
+            Block b = scan(buf);
+            std::uint64_t m = (n == 0 ? 0 : ~std::uint64_t(0) >> (BLOCK_SIZE - n));
+            b.separator &= m;
+            b.quote &= m;
+            b.ending &= m;
+            return b;
+        }
+
+        static int popCount(std::uint64_t m) {
+#if defined(__GNUC__) || defined(__clang__)
+            return __builtin_popcountll(m);
+#else
+            int i = 0;
+            for (; m != 0; m &= m - 1)
+                ++i;
+            return i;
+#endif
+        }
+
+        static int trailingZeros(std::uint64_t m) {
+#if defined(__GNUC__) || defined(__clang__)
+            return __builtin_ctzll(m);
+#elif defined(_MSC_VER) && defined(_M_X64)
+            unsigned long i;
+            _BitScanForward64(&i, m);
+            return static_cast<int>(i);
+#else
+            int i = 0;
+            for (; !(m & 1); m >>= 1)
+                ++i;
+            return i;
+#endif
+        }
+
+        // Marks the bytes inside quoted regions (from an opening quote up to,
+        // not including, its closing quote); `inside` carries the state across blocks.
+        static std::uint64_t quoteMask(std::uint64_t quote, std::uint64_t& inside) {
+            std::uint64_t m = quote;
+            m ^= m << 1;
+            m ^= m << 2;
+            m ^= m << 4;
+            m ^= m << 8;
+            m ^= m << 16;
+            m ^= m << 32;
+            m ^= inside;
+            inside = static_cast<std::uint64_t>(-static_cast<std::int64_t>(m >> 63));
+            return m;
+        }
+
+        // Like quoteMask(), but a quote opens a quoted region only at the start
+        // of a field or right after another quote (""); any other quote is
+        // literal text and is dropped from b.quote. `carry` is the state left
+        // by the previous block, FIELD_START (or carryAt()) before the first.
+        std::uint64_t fieldQuoteMask(Block& b, std::uint64_t& inside, std::uint64_t& carry) const {
+            const std::uint64_t in = inside;
+            for (;;) {
+                std::uint64_t pre = b.separator | b.ending | b.quote;
+                if (crlf_)
+                    pre |= (b.ending << 1) | (carry >> 1); // the '\n' of "\r\n"
+                std::uint64_t m = quoteMask(b.quote, inside);
+                std::uint64_t stray = b.quote & m & ~((pre << 1) | (carry & 1));
+                if (stray == 0) {
+                    carry = (pre >> 63) | (crlf_ ? (b.ending >> 63) << 1 : 0);
+                    return m;
+                }
+                b.quote &= ~(stray & (~stray + 1));
+                inside = in;
+            }
+        }
+
+        // The carry of fieldQuoteMask() for a block starting at p > begin.
+        std::uint64_t carryAt(const char* begin, const char* p) const {
+            char c = p[-1];
+            bool pre = c == separator_ || c == ending_ || c == ending2_ || c == '"' ||
+                       (crlf_ && c == '\n' && p - 1 > begin && p[-2] == '\r');
+            return std::uint64_t(pre) | (std::uint64_t(crlf_ && c == '\r') << 1);
+        }
+
+    private:
+        static std::uint64_t match(const char* p, char c) {
+#if defined(TABXX_CSV_AVX2)
+            const __m256i v = _mm256_set1_epi8(c);
+            std::uint32_t lo = static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(
+                _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)), v)));
+            std::uint32_t hi = static_cast<std::uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(
+                _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + 32)), v)));
+            return (std::uint64_t(hi) << 32) | lo;
+#elif defined(TABXX_CSV_SSE2)
+            const __m128i v = _mm_set1_epi8(c);
+            std::uint64_t ret = 0;
+            for (int i = 0; i < 4; ++i) {
+                __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 16 * i));
+                ret |= std::uint64_t(static_cast<std::uint16_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(x, v)))) << (16 * i);
+            }
+            return ret;
+#elif defined(TABXX_CSV_NEON)
+            const uint8x16_t v = vdupq_n_u8(static_cast<std::uint8_t>(c));
+            const uint8x16_t bits = {1, 2, 4, 8, 16, 32, 64, 128, 1, 2, 4, 8, 16, 32, 64, 128};
+            const std::uint8_t* q = reinterpret_cast<const std::uint8_t*>(p);
+            uint8x16_t m0 = vandq_u8(vceqq_u8(vld1q_u8(q), v), bits);
+            uint8x16_t m1 = vandq_u8(vceqq_u8(vld1q_u8(q + 16), v), bits);
+            uint8x16_t m2 = vandq_u8(vceqq_u8(vld1q_u8(q + 32), v), bits);
+            uint8x16_t m3 = vandq_u8(vceqq_u8(vld1q_u8(q + 48), v), bits);
+            uint8x16_t sum = vpaddq_u8(vpaddq_u8(m0, m1), vpaddq_u8(m2, m3));
+            sum = vpaddq_u8(sum, sum);
+            return vgetq_lane_u64(vreinterpretq_u64_u8(sum), 0);
+#else
+            std::uint64_t ret = 0;
+            for (std::size_t i = 0; i < BLOCK_SIZE; ++i)
+                ret |= std::uint64_t(p[i] == c) << i;
+            return ret;
+#endif
+        }
+
+    private:
+        char separator_;
+        char ending_;
+        char ending2_;
+        bool crlf_;
+
+    }; // class Scanner
+
+    // Formats output into a large internal buffer and hands it to the sink in blocks.
+    class Writer {
+    public:
+        explicit Writer(std::ostream& des, std::size_t buffer = 1 << 20) :
+            stream_(&des), file_(nullptr), string_(nullptr), fd_(-1), buffer_(buffer < 256 ? 256 : buffer), pos_(0), written_(0) {}
+
+        explicit Writer(std::FILE* des, std::size_t buffer = 1 << 20) :
+            stream_(nullptr), file_(des), string_(nullptr), fd_(-1), buffer_(buffer < 256 ? 256 : buffer), pos_(0), written_(0) {}
+
+        // Appends to des.
+        explicit Writer(std::string& des, std::size_t buffer = 1 << 16) :
+            stream_(nullptr), file_(nullptr), string_(&des), fd_(-1), buffer_(buffer < 256 ? 256 : buffer), pos_(0), written_(0) {}
+
+#ifdef TABXX_CSV_HAS_MMAP
+        explicit Writer(int fd, std::size_t buffer = 1 << 20) :
+            stream_(nullptr), file_(nullptr), string_(nullptr), fd_(fd), buffer_(buffer < 256 ? 256 : buffer), pos_(0), written_(0) {}
+#endif
+
+        Writer(const Writer&) = delete;
+        Writer& operator=(const Writer&) = delete;
+
+        // Errors are only reported by an explicit flush().
+        ~Writer() {
+            try {
+                flush();
+            }
+            catch (...) {
+            }
+        }
+
+        void put(char c) {
+            if (pos_ == buffer_.size())
+                flush();
+            buffer_[pos_++] = c;
+        }
+
+        void put(std::string_view v) {
+            if (v.size() > buffer_.size() - pos_) {
+                flush();
+                if (v.size() > buffer_.size()) {
+                    sink(v.data(), v.size());
+                    return;
+                }
+            }
+            std::memcpy(buffer_.data() + pos_, v.data(), v.size());
+            pos_ += v.size();
+        }
+
+        void putInt(long long v) {
+            reserve(24);
+            pos_ = std::to_chars(buffer_.data() + pos_, buffer_.data() + buffer_.size(), v).ptr - buffer_.data();
+        }
+
+        void putDouble(double v, int precision) {
+            reserve(128);
+            if (char* e = formatDouble(buffer_.data() + pos_, buffer_.data() + buffer_.size(), v, precision)) {
+                pos_ = e - buffer_.data();
+                return;
+            }
+            std::string str(std::numeric_limits<double>::max_exponent10 + precision + 8, '\0');
+            str.resize(formatDouble(&str[0], &str[0] + str.size(), v, precision) - str.data());
+            put(str);
+        }
+
+        void flush() {
+            if (pos_ != 0) {
+                std::size_t n = pos_;
+                pos_ = 0;
+                sink(buffer_.data(), n);
+            }
+        }
+
+        // Bytes accepted so far, including those still buffered.
+        std::size_t size() const {
+            return written_ + pos_;
+        }
+
+    private:
+        void reserve(std::size_t n) {
+            if (buffer_.size() - pos_ < n)
+                flush();
+        }
+
+        void sink(const char* p, std::size_t n) {
+            if (stream_ != nullptr) {
+                stream_->write(p, static_cast<std::streamsize>(n));
+                if (!*stream_)
+                    throw std::runtime_error("tabxx::CSV::Writer::flush(): Stream write failed");
+            }
+            else if (file_ != nullptr) {
+                if (std::fwrite(p, 1, n, file_) != n)
+                    throw std::runtime_error("tabxx::CSV::Writer::flush(): File write failed");
+            }
+            else if (string_ != nullptr)
+                string_->append(p, n);
+#ifdef TABXX_CSV_HAS_MMAP
+            else {
+                while (n != 0) {
+                    ssize_t r = ::write(fd_, p, n);
+                    if (r < 0) {
+                        if (errno == EINTR)
+                            continue;
+                        throw std::runtime_error("tabxx::CSV::Writer::flush(): Descriptor write failed");
+                    }
+                    p += r;
+                    n -= static_cast<std::size_t>(r);
+                    written_ += static_cast<std::size_t>(r);
+                }
+                return;
+            }
+#endif
+            written_ += n;
+        }
+
+    private:
+        std::ostream* stream_;
+        std::FILE* file_;
+        std::string* string_;
+        int fd_;
+        std::vector<char> buffer_;
+        std::size_t pos_;
+        std::size_t written_;
+
+    }; // class Writer
+
+    // AUTO detects GZIP and ZSTD input by its magic bytes and passes anything
+    // else through unchanged.
+    enum CODEC {PLAIN, GZIP, ZSTD, AUTO};
+
+    // Decompresses a stream on the fly, so the parser never needs the whole
+    // decompressed file: large reads are inflated straight into the caller's
+    // buffer. Concatenated gzip members and zstd frames are read in sequence.
+    class DecompressStream : public std::istream {
+    public:
+        explicit DecompressStream(std::istream& src, CODEC codec = AUTO, std::size_t buffer = 1 << 16) :
+            std::istream(nullptr), buf_(src, codec, buffer) {
+            rdbuf(&buf_);
+            exceptions(std::ios::badbit); // corrupt or truncated input throws
+        }
+
+        CODEC getCodec() const {
+            return buf_.codec_;
+        }
+
+    private:
+        class Buffer : public std::streambuf {
+        public:
+            Buffer(std::istream& src, CODEC codec, std::size_t buffer) :
+                src_(src), codec_(codec), in_(std::max<std::size_t>(buffer, 256)), out_(in_.size()),
+                begin_(0), end_(0), eof_(false), done_(false) {
+                fill();
+                if (codec_ == AUTO) {
+                    const unsigned char* p = reinterpret_cast<const unsigned char*>(in_.data());
+                    if (end_ >= 2 && p[0] == 0x1f && p[1] == 0x8b)
+                        codec_ = GZIP;
+                    else if (end_ >= 4 && p[0] == 0x28 && p[1] == 0xb5 && p[2] == 0x2f && p[3] == 0xfd)
+                        codec_ = ZSTD;
+                    else
+                        codec_ = PLAIN;
+                }
+                if (codec_ == GZIP) {
+#ifdef TABXX_CSV_ZLIB
+                    std::memset(&zlib_, 0, sizeof(zlib_));
+                    if (inflateInit2(&zlib_, 15 + 32) != Z_OK)
+                        throw std::runtime_error("tabxx::CSV::DecompressStream(): inflateInit2() failed");
+#else
+                    throw std::runtime_error("tabxx::CSV::DecompressStream(): GZIP needs TABXX_CSV_ZLIB");
+#endif
+                }
+                else if (codec_ == ZSTD) {
+#ifdef TABXX_CSV_ZSTD
+                    zstd_ = ZSTD_createDCtx();
+                    if (zstd_ == nullptr)
+                        throw std::runtime_error("tabxx::CSV::DecompressStream(): ZSTD_createDCtx() failed");
+#else
+                    throw std::runtime_error("tabxx::CSV::DecompressStream(): ZSTD needs TABXX_CSV_ZSTD");
+#endif
+                }
+            }
+
+            Buffer(const Buffer&) = delete;
+            Buffer& operator=(const Buffer&) = delete;
+
+            ~Buffer() {
+#ifdef TABXX_CSV_ZLIB
+                if (codec_ == GZIP)
+                    inflateEnd(&zlib_);
+#endif
+#ifdef TABXX_CSV_ZSTD
+                if (codec_ == ZSTD)
+                    ZSTD_freeDCtx(zstd_);
+#endif
+            }
+
+        protected:
+            int_type underflow() override {
+                if (gptr() < egptr())
+                    return traits_type::to_int_type(*gptr());
+                std::size_t n = decompress(out_.data(), out_.size());
+                if (n == 0)
+                    return traits_type::eof();
+                setg(out_.data(), out_.data(), out_.data() + n);
+                return traits_type::to_int_type(*gptr());
+            }
+
+            std::streamsize xsgetn(char* s, std::streamsize count) override {
+                std::size_t n = static_cast<std::size_t>(count);
+                std::size_t got = 0;
+                while (got < n) {
+                    if (gptr() < egptr()) {
+                        std::size_t k = std::min<std::size_t>(egptr() - gptr(), n - got);
+                        std::memcpy(s + got, gptr(), k);
+                        gbump(static_cast<int>(k));
+                        got += k;
+                    }
+                    else if (n - got >= out_.size()) {
+                        std::size_t k = decompress(s + got, n - got);
+                        if (k == 0)
+                            break;
+                        got += k;
+                    }
+                    else if (traits_type::eq_int_type(underflow(), traits_type::eof()))
+                        break;
+                }
+                return static_cast<std::streamsize>(got);
+            }
+
+        private:
+            // Moves unread input to the front and reads more after it.
+            void fill() {
+                if (eof_)
+                    return;
+                if (begin_ != 0) {
+                    std::memmove(in_.data(), in_.data() + begin_, end_ - begin_);
+                    end_ -= begin_;
+                    begin_ = 0;
+                }
+                src_.read(in_.data() + end_, static_cast<std::streamsize>(in_.size() - end_));
+                end_ += static_cast<std::size_t>(src_.gcount());
+                eof_ = !src_;
+            }
+
+            // Produces up to n bytes into out; returns 0 at the end of the data.
+            std::size_t decompress(char* out, std::size_t n) {
+                for (; ; ) {
+                    if (begin_ == end_)
+                        fill();
+                    if (codec_ == PLAIN) {
+                        std::size_t k = std::min(n, end_ - begin_);
+                        std::memcpy(out, in_.data() + begin_, k);
+                        begin_ += k;
+                        return k;
+                    }
+                    if (done_ && begin_ == end_)
+                        return 0;
+                    std::size_t before = begin_;
+                    std::size_t k = step(out, n);
+                    if (k != 0)
+                        return k;
+                    if (begin_ == before) { // the codec needs more input
+                        if (eof_)
+                            throw std::runtime_error("tabxx::CSV::DecompressStream(): Truncated input");
+                        fill();
+                    }
+                }
+            }
+
+            // Runs the codec once over the buffered input.
+            std::size_t step(char* out, std::size_t n) {
+#ifdef TABXX_CSV_ZLIB
+                if (codec_ == GZIP) {
+                    if (done_) { // another gzip member follows
+                        inflateReset(&zlib_);
+                        done_ = false;
+                    }
+                    zlib_.next_in = reinterpret_cast<Bytef*>(in_.data() + begin_);
+                    zlib_.avail_in = static_cast<uInt>(std::min<std::size_t>(end_ - begin_, std::numeric_limits<uInt>::max()));
+                    zlib_.next_out = reinterpret_cast<Bytef*>(out);
+                    zlib_.avail_out = static_cast<uInt>(std::min<std::size_t>(n, std::numeric_limits<uInt>::max()));
+                    int r = inflate(&zlib_, Z_NO_FLUSH);
+                    if (r != Z_OK && r != Z_STREAM_END && r != Z_BUF_ERROR)
+                        throw std::runtime_error("tabxx::CSV::DecompressStream(): Corrupt gzip data");
+                    begin_ = reinterpret_cast<char*>(zlib_.next_in) - in_.data();
+                    done_ = (r == Z_STREAM_END);
+                    return reinterpret_cast<char*>(zlib_.next_out) - out;
+                }
+#endif
+#ifdef TABXX_CSV_ZSTD
+                if (codec_ == ZSTD) {
+                    ZSTD_inBuffer in = {in_.data(), end_, begin_};
+                    ZSTD_outBuffer o = {out, n, 0};
+                    std::size_t r = ZSTD_decompressStream(zstd_, &o, &in);
+                    if (ZSTD_isError(r))
+                        throw std::runtime_error(std::string("tabxx::CSV::DecompressStream(): ") + ZSTD_getErrorName(r));
+                    begin_ = in.pos;
+                    done_ = (r == 0);
+                    return o.pos;
+                }
+#endif
+                (void)out;
+                (void)n;
+                return 0;
+            }
+
+            std::istream& src_;
+            CODEC codec_;
+            std::vector<char> in_;
+            std::vector<char> out_;
+            std::size_t begin_;
+            std::size_t end_;
+            bool eof_;
+            bool done_; // at the end of a gzip member or zstd frame
+#ifdef TABXX_CSV_ZLIB
+            z_stream zlib_;
+#endif
+#ifdef TABXX_CSV_ZSTD
+            ZSTD_DCtx* zstd_;
+#endif
+            friend class DecompressStream;
+
+        }; // class Buffer
+
+        Buffer buf_;
+
+    }; // class DecompressStream
+
+    // Compresses everything written to it into des. The compressed stream is
+    // complete once finish() is called or the stream is destroyed.
+    class CompressStream : public std::ostream {
+    public:
+        // `level` 0 picks the codec's default; `threads` > 1 enables zstd's
+        // multi-threaded compression where the library supports it.
+        CompressStream(std::ostream& des, CODEC codec, int level = 0, unsigned threads = 1, std::size_t buffer = 1 << 16) :
+            std::ostream(nullptr), buf_(des, codec, level, threads, buffer) {
+            rdbuf(&buf_);
+        }
+
+        ~CompressStream() {
+            try {
+                buf_.finish();
+            }
+            catch (...) {
+            }
+        }
+
+        // Writes the remaining data and the trailer; throws on failure.
+        void finish() {
+            buf_.finish();
+        }
+
+    private:
+        class Buffer : public std::streambuf {
+        public:
+            Buffer(std::ostream& des, CODEC codec, int level, unsigned threads, std::size_t buffer) :
+                des_(des), codec_(codec), in_(std::max<std::size_t>(buffer, 256)), out_(in_.size()), finished_(false) {
+                if (codec_ == GZIP) {
+#ifdef TABXX_CSV_ZLIB
+                    std::memset(&zlib_, 0, sizeof(zlib_));
+                    if (deflateInit2(&zlib_, level == 0 ? Z_DEFAULT_COMPRESSION : level, Z_DEFLATED, 15 + 16, 8,
+                                     Z_DEFAULT_STRATEGY) != Z_OK)
+                        throw std::runtime_error("tabxx::CSV::CompressStream(): deflateInit2() failed");
+#else
+                    throw std::runtime_error("tabxx::CSV::CompressStream(): GZIP needs TABXX_CSV_ZLIB");
+#endif
+                }
+                else if (codec_ == ZSTD) {
+#ifdef TABXX_CSV_ZSTD
+                    zstd_ = ZSTD_createCCtx();
+                    if (zstd_ == nullptr)
+                        throw std::runtime_error("tabxx::CSV::CompressStream(): ZSTD_createCCtx() failed");
+                    if (level != 0)
+                        ZSTD_CCtx_setParameter(zstd_, ZSTD_c_compressionLevel, level);
+                    if (threads > 1)
+                        ZSTD_CCtx_setParameter(zstd_, ZSTD_c_nbWorkers, static_cast<int>(threads));
+#else
+                    throw std::runtime_error("tabxx::CSV::CompressStream(): ZSTD needs TABXX_CSV_ZSTD");
+#endif
+                }
+                else if (codec_ != PLAIN)
+                    throw std::runtime_error("tabxx::CSV::CompressStream(): Invalid codec");
+                (void)level;
+                (void)threads;
+                setp(in_.data(), in_.data() + in_.size());
+            }
+
+            Buffer(const Buffer&) = delete;
+            Buffer& operator=(const Buffer&) = delete;
+
+            ~Buffer() {
+#ifdef TABXX_CSV_ZLIB
+                if (codec_ == GZIP)
+                    deflateEnd(&zlib_);
+#endif
+#ifdef TABXX_CSV_ZSTD
+                if (codec_ == ZSTD)
+                    ZSTD_freeCCtx(zstd_);
+#endif
+            }
+
+            void finish() {
+                if (finished_)
+                    return;
+                finished_ = true;
+                compress(true);
+                des_.flush();
+                if (!des_)
+                    throw std::runtime_error("tabxx::CSV::CompressStream::finish(): Stream write failed");
+            }
+
+        protected:
+            int_type overflow(int_type c) override {
+                if (finished_)
+                    return traits_type::eof();
+                compress(false);
+                if (!traits_type::eq_int_type(c, traits_type::eof())) {
+                    *pptr() = traits_type::to_char_type(c);
+                    pbump(1);
+                }
+                return traits_type::not_eof(c);
+            }
+
+            // Hands buffered bytes to the codec; the codec may still hold some
+            // of them until finish().
+            int sync() override {
+                if (finished_)
+                    return 0;
+                try {
+                    compress(false);
+                }
+                catch (...) {
+                    return -1;
+                }
+                return des_ ? 0 : -1;
+            }
+
+        private:
+            void compress(bool end) {
+                const char* p = pbase();
+                std::size_t n = static_cast<std::size_t>(pptr() - pbase());
+                setp(in_.data(), in_.data() + in_.size());
+                if (codec_ == PLAIN) {
+                    des_.write(p, static_cast<std::streamsize>(n));
+                    return;
+                }
+#ifdef TABXX_CSV_ZLIB
+                if (codec_ == GZIP) {
+                    zlib_.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(p));
+                    zlib_.avail_in = static_cast<uInt>(n);
+                    for (; ; ) {
+                        zlib_.next_out = reinterpret_cast<Bytef*>(out_.data());
+                        zlib_.avail_out = static_cast<uInt>(out_.size());
+                        int r = deflate(&zlib_, end ? Z_FINISH : Z_NO_FLUSH);
+                        if (r == Z_STREAM_ERROR)
+                            throw std::runtime_error("tabxx::CSV::CompressStream(): deflate() failed");
+                        des_.write(out_.data(), static_cast<std::streamsize>(out_.size() - zlib_.avail_out));
+                        if (end ? r == Z_STREAM_END : (zlib_.avail_in == 0 && zlib_.avail_out != 0))
+                            break;
+                    }
+                }
+#endif
+#ifdef TABXX_CSV_ZSTD
+                if (codec_ == ZSTD) {
+                    ZSTD_inBuffer in = {p, n, 0};
+                    for (; ; ) {
+                        ZSTD_outBuffer o = {out_.data(), out_.size(), 0};
+                        std::size_t r = ZSTD_compressStream2(zstd_, &o, &in, end ? ZSTD_e_end : ZSTD_e_continue);
+                        if (ZSTD_isError(r))
+                            throw std::runtime_error(std::string("tabxx::CSV::CompressStream(): ") + ZSTD_getErrorName(r));
+                        des_.write(out_.data(), static_cast<std::streamsize>(o.pos));
+                        if (end ? r == 0 : in.pos == in.size)
+                            break;
+                    }
+                }
+#endif
+                (void)end;
+            }
+
+            std::ostream& des_;
+            CODEC codec_;
+            std::vector<char> in_;
+            std::vector<char> out_;
+            bool finished_;
+#ifdef TABXX_CSV_ZLIB
+            z_stream zlib_;
+#endif
+#ifdef TABXX_CSV_ZSTD
+            ZSTD_CCtx* zstd_;
+#endif
+
+        }; // class Buffer
+
+        Buffer buf_;
+
+    }; // class CompressStream
+
+private:
+    // Blocking FIFO with a fixed capacity, shared by the stages of a pipeline.
+    template <typename T>
+    class BoundedQueue {
+    public:
+        explicit BoundedQueue(std::size_t capacity) : capacity_(std::max<std::size_t>(capacity, 1)), closed_(false) {}
+
+        BoundedQueue(const BoundedQueue&) = delete;
+        BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+        // Waits for free space; returns false (leaving v untouched) once closed.
+        bool push(T&& v) {
+            std::unique_lock<std::mutex> lock(mutex_);
+            not_full_.wait(lock, [&]() { return closed_ || items_.size() < capacity_; });
+            if (closed_)
+                return false;
+            items_.push_back(std::move(v));
+            not_empty_.notify_one();
+            return true;
+        }
+
+        // Waits for an item; returns false once closed and drained.
+        bool pop(T& v) {
+            std::unique_lock<std::mutex> lock(mutex_);
+            not_empty_.wait(lock, [&]() { return closed_ || !items_.empty(); });
+            if (items_.empty())
+                return false;
+            v = std::move(items_.front());
+            items_.pop_front();
+            not_full_.notify_one();
+            return true;
+        }
+
+        void close() {
+            std::lock_guard<std::mutex> lock(mutex_);
+            closed_ = true;
+            not_full_.notify_all();
+            not_empty_.notify_all();
+        }
+
+    private:
+        std::size_t capacity_;
+        bool closed_;
+        std::deque<T> items_;
+        std::mutex mutex_;
+        std::condition_variable not_full_;
+        std::condition_variable not_empty_;
+
+    }; // class BoundedQueue
+
+    // Reads a stream block by block, on a separate thread `depth` blocks
+    // ahead of the caller when depth > 0.
+    class Prefetcher {
+    public:
+        Prefetcher(std::istream& src, std::size_t block, std::size_t depth) :
+            src_(src), block_(block), queue_(depth) {
+            if (depth > 0)
+                thread_ = std::thread([this]() { run(); });
+        }
+
+        Prefetcher(const Prefetcher&) = delete;
+        Prefetcher& operator=(const Prefetcher&) = delete;
+
+        ~Prefetcher() {
+            close();
+            if (thread_.joinable())
+                thread_.join();
+        }
+
+        // Appends the next block to buf; returns false once the input is exhausted.
+        bool read(std::string& buf) {
+            if (!thread_.joinable())
+                return readBlock(buf);
+            Block b;
+            if (!queue_.pop(b)) {
+                if (error_)
+                    std::rethrow_exception(error_);
+                return false;
+            }
+            if (buf.empty())
+                buf.swap(b.data);
+            else
+                buf.append(b.data);
+            return !b.last;
+        }
+
+        // Stops the reading thread early.
+        void close() {
+            queue_.close();
+        }
+
+    private:
+        struct Block {
+            std::string data;
+            bool last;
+        };
+
+        bool readBlock(std::string& buf) {
+            std::size_t n = buf.size();
+            buf.resize(n + block_);
+            src_.read(&buf[n], block_);
+            buf.resize(n + static_cast<std::size_t>(src_.gcount()));
+            return static_cast<bool>(src_);
+        }
+
+        void run() {
+            try {
+                for (bool more = true; more; ) {
+                    Block b;
+                    more = readBlock(b.data);
+                    b.last = !more;
+                    if (!queue_.push(std::move(b)))
+                        return;
+                }
+            }
+            catch (...) {
+                error_ = std::current_exception();
+            }
+            queue_.close();
+        }
+
+    private:
+        std::istream& src_;
+        std::size_t block_;
+        BoundedQueue<Block> queue_;
+        std::exception_ptr error_;
+        std::thread thread_;
+
+    }; // class Prefetcher
+
+public:
+    class Reader;
+    class BatchReader;
+    class SpillTable;
+
+    CSV(const Settings& settings = Settings()) : settings_(settings), width_(0), rows_(0), transient_(false) {}
+
+    CSV(std::istream& src, const Settings& s = Settings()) : CSV(s) {
+        this->parse(src);
+    }
+
+    CSV(const std::string& str, const Settings& s = Settings()) : CSV(str.data(), str.size(), s) {}
+
+    CSV(const char* str, std::size_t size, const Settings& s = Settings()) : CSV(s) {
+        this->parseBuffer(str, size);
+    }
+
+    static CSV parse(const std::string& str, const Settings& settings = Settings()) {
+        return CSV(str, settings);
+    }
+
+    static CSV parse(const char* str, std::size_t size, const Settings& settings = Settings()) {
+        return CSV(str, size, settings);
+    }
+
+    static CSV parseFile(const std::string& path, const Settings& settings = Settings()) {
+        auto file = std::make_shared<MappedFile>(path);
+        CSV ret(file->data(), file->size(), settings);
+        if (settings.zero_copy_)
+            ret.source_ = std::move(file);
+        return ret;
+    }
+
+    // Parses files with identical headers into one table, in the given
+    // order. Each file is cut into chunks of about setChunkSize() bytes and
+    // the threads take chunks of all files from one queue, so a few large
+    // files among many small ones still keep every thread busy. Empty files
+    // are skipped. With zero-copy settings the files stay mapped as long as
+    // the table views them.
+    static CSV parseFiles(const std::vector<std::string>& paths, const Settings& settings = Settings()) {
+        CSV ret(settings);
+        const unsigned threads = ret.settings_.threadCount();
+        std::vector<std::shared_ptr<MappedFile>> files;
+        std::vector<CSV> layouts;
+        std::vector<std::pair<std::size_t, const char*>> chunks; // file, chunk start
+        std::vector<const char*> ends;
+        const std::string* reference = nullptr; // file whose header the others must match
+        for (auto&& path : paths) {
+            auto file = std::make_shared<MappedFile>(path);
+            CSV layout(settings);
+            const char* end = file->data() + file->size();
+            const char* p = layout.parseTitle(file->data(), end, true);
+            if (layout.title_.empty())
+                continue;
+            if (layouts.empty())
+                reference = &path;
+            else if (layout.title_ != layouts[0].title_)
+                throw std::runtime_error("tabxx::CSV::parseFiles(): Header of " + path + " differs from " + *reference);
+            std::vector<const char*> bounds = layout.splitChunks(p, end, threads);
+            for (std::size_t i = 0; i + 1 < bounds.size(); ++i) {
+                chunks.emplace_back(layouts.size(), bounds[i]);
+                ends.push_back(bounds[i + 1]);
+            }
+            files.push_back(std::move(file));
+            layouts.push_back(std::move(layout));
+        }
+        if (layouts.empty())
+            return ret;
+        Timer timer(ret.settings_, "csv.parse");
+        layouts[0].copyLayout(ret);
+        ret.settings_.ending_ = layouts[0].settings_.ending_;
+
+        std::vector<CSV> parts;
+        parts.reserve(chunks.size());
+        for (auto&& c : chunks)
+            parts.emplace_back(layouts[c.first].settings_);
+        std::vector<ParseStats> local(ret.settings_.stats_ != nullptr ? parts.size() : 0);
+        for (std::size_t i = 0; i < local.size(); ++i)
+            parts[i].settings_.stats_ = &local[i];
+        runParallel(parts.size(), threads, [&](std::size_t i) {
+            Timer span(parts[i].settings_, "csv.chunk");
+            layouts[chunks[i].first].copyLayout(parts[i]);
+            parts[i].parseRows(chunks[i].second, ends[i], true);
+        });
+        for (auto&& x : local)
+            ret.settings_.stats_->merge(x);
+        Timer merge(ret.settings_, "csv.merge", &ParseStats::merge_ns);
+        runParallel(ret.columns_.size(), threads, [&](std::size_t j) {
+            for (auto&& part : parts)
+                ret.columns_[j].append(std::move(part.columns_[j]));
+        });
+        for (auto&& part : parts)
+            ret.rows_ += part.rows_;
+        if (settings.zero_copy_)
+            ret.source_ = std::make_shared<std::vector<std::shared_ptr<MappedFile>>>(std::move(files));
+        return ret;
+    }
+
+    // Restores a table saved by writeSnapshot() without parsing text. With
+    // zero-copy settings, string columns view the input directly (which must
+    // then outlive the table), otherwise everything is copied.
+    static CSV loadSnapshot(const char* data, std::size_t size, const Settings& settings = Settings()) {
+        CSV ret(settings);
+        ret.settings_.clearSchema().clearSelection().setRowFilter(nullptr);
+        ret.readSnapshot(data, size);
+        return ret;
+    }
+
+    // The file is memory-mapped; with zero-copy settings it stays mapped as
+    // long as the table views it.
+    static CSV loadSnapshot(const std::string& path, const Settings& settings = Settings()) {
+        auto file = std::make_shared<MappedFile>(path);
+        CSV ret = loadSnapshot(file->data(), file->size(), settings);
+        if (settings.zero_copy_)
+            ret.source_ = std::move(file);
+        return ret;
+    }
+
+    std::size_t getColumnCount() {
+        return title_.size();
+    }
+
+    std::size_t getRowCount() {
+        return rows_;
+    }
+
+    std::vector<std::string> getColumns() {
+        return title_;
+    }
+
+    std::vector<std::any> getRow(std::size_t row) {
+        if (row >= rows_)
+            throw std::out_of_range("tabxx::CSV::getRow(): Index out of range");
+        std::vector<std::any> ret;
+        ret.reserve(columns_.size());
+        for (auto&& col : columns_)
+            ret.emplace_back(col.get(row));
+        return ret;
+    }
+
+    std::vector<std::any> getColumn(std::size_t column) {
+        std::vector<std::any> ret;
+        if (column < columns_.size()) {
+            const Column& col = columns_[column];
+            ret.reserve(rows_);
+            for (std::size_t i = 0; i < rows_; ++i)
+                ret.emplace_back(col.get(i));
+        }
+        return ret;
+    }
+
+    std::vector<std::any> getColumn(const std::string& column) {
+        return getColumn(searchTitle(column));
+    }
+
+    const Column& getColumnData(std::size_t column) {
+        return columns_.at(column);
+    }
+
+    const Column& getColumnData(const std::string& column) {
+        return columns_.at(searchTitle(column));
+    }
+
+    // A copy of the cell, const so that assigning to it does not compile;
+    // setValue() changes a cell.
+    const std::any getValue(std::size_t column, std::size_t row) {
+        return columns_.at(column).get(row);
+    }
+
+    template <typename V>
+    V getValue(std::size_t column, std::size_t row) {
+        return columns_.at(column).template get<V>(row);
+    }
+
+    const std::any getValue(const std::string& column, std::size_t row) {
+        return getValue(searchTitle(column), row);
+    }
+
+    template <typename V>
+    V getValue(const std::string& column, std::size_t row) {
+        return getValue<V>(searchTitle(column), row);
+    }
+
+    // Up to `rows` rows starting at `begin`.
+    RowBlock getBlock(std::size_t begin, std::size_t rows) const {
+        if (begin > rows_)
+            throw std::out_of_range("tabxx::CSV::getBlock(): Index out of range");
+        return RowBlock(this, begin, std::min(rows, rows_ - begin));
+    }
+
+    // Calls f(block) for consecutive blocks of `rows` rows (the last may be
+    // shorter) and returns the number of blocks.
+    template <typename F>
+    std::size_t forEachBlock(std::size_t rows, F&& f) const {
+        if (rows == 0)
+            throw std::runtime_error("tabxx::CSV::forEachBlock(): Block size must be positive");
+        std::size_t n = 0;
+        for (std::size_t i = 0; i < rows_; i += rows, ++n)
+            f(getBlock(i, rows));
+        return n;
+    }
+
+    // Calls f(row) with every row converted through the mapping; names
+    // refer to this table's titles.
+    template <typename Row, typename F>
+    void forEachRow(const RowMapping<Row>& mapping, F&& f) const {
+        std::vector<std::size_t> columns = resolve(mapping, title_.size(), [&](const std::string& name) {
+            auto ite = index_.find(name);
+            if (ite == index_.end())
+                throw std::runtime_error("tabxx::CSV::forEachRow(): Unknown column " + name);
+            return ite->second;
+        });
+        for (std::size_t i = 0; i < rows_; ++i) {
+            Row row{};
+            for (std::size_t k = 0; k < columns.size(); ++k)
+                mapping.bindings_[k].cell(row, columns_[columns[k]], i);
+            f(row);
+        }
+    }
+
+    template <typename Row>
+    std::vector<Row> getRows(const RowMapping<Row>& mapping) const {
+        std::vector<Row> ret;
+        ret.reserve(rows_);
+        forEachRow(mapping, [&](Row& row) {
+            ret.push_back(std::move(row));
+        });
+        return ret;
+    }
+
+    // Parses records straight into Row objects without building a table and
+    // calls f(row) for each. Names and indices refer to the input columns;
+    // only the row filter and format settings apply. std::string_view
+    // members point into the input block and are valid only during f.
+    template <typename Row, typename F>
+    static void forEachRecord(std::istream& src, const RowMapping<Row>& mapping, F&& f,
+                              const Settings& settings = Settings()) {
+        CSV reader(settings);
+        std::vector<std::size_t> columns;
+        reader.scan(src, [&](const char* p, const char* end, bool last) {
+            return reader.mapRecords(p, end, last, mapping, columns, f);
+        });
+    }
+
+    template <typename Row, typename F>
+    static void forEachRecord(const char* data, std::size_t size, const RowMapping<Row>& mapping, F&& f,
+                              const Settings& settings = Settings()) {
+        CSV reader(settings);
+        std::vector<std::size_t> columns;
+        const char* p = reader.parseTitle(data, data + size, true);
+        if (!reader.title_.empty())
+            reader.mapRecords(p, data + size, true, mapping, columns, f);
+    }
+
+    template <typename Row>
+    static std::vector<Row> readRows(std::istream& src, const RowMapping<Row>& mapping,
+                                     const Settings& settings = Settings()) {
+        std::vector<Row> ret;
+        forEachRecord(src, mapping, [&](Row& row) {
+            ret.push_back(std::move(row));
+        }, settings);
+        return ret;
+    }
+
+    template <typename Row>
+    static std::vector<Row> readRows(const char* data, std::size_t size, const RowMapping<Row>& mapping,
+                                     const Settings& settings = Settings()) {
+        std::vector<Row> ret;
+        forEachRecord(data, size, mapping, [&](Row& row) {
+            ret.push_back(std::move(row));
+        }, settings);
+        return ret;
+    }
+
+    ColumnHandle getHandle(const std::string& column) {
+        return ColumnHandle(this, searchTitle(column));
+    }
+
+    void setValue(std::size_t column, std::size_t row, const std::any& v) {
+        Column& col = columns_.at(column);
+        for (auto&& ix : indexes_)
+            if (ix.column == column && row < rows_)
+                unindexRow(ix, row);
+        col.set(row, v);
+        for (auto&& ix : indexes_)
+            if (ix.column == column)
+                indexRow(ix, row);
+    }
+
+    void setValue(const std::string& column, std::size_t row, const std::any& v) {
+        setValue(searchTitle(column), row, v);
+    }
+
+    std::vector<std::string> getTitles() {
+        return this->title_;
+    }
+
+    void setTitle(const std::vector<std::string>& t) {
+        clear();
+        title_ = t;
+        width_ = title_.size();
+        indexTitle();
+    }
+
+    void setTitle(std::vector<std::string>&& t) {
+        clear();
+        title_ = std::move(t);
+        width_ = title_.size();
+        indexTitle();
+    }
+
+    void addRow(const std::vector<std::any>& l) {
+        if (l.size() != title_.size())
+            throw std::runtime_error("tabxx::CSV::addRow(): Invalid value count");
+        for (std::size_t i = 0; i < l.size(); ++i)
+            columns_[i].push(l[i]);
+        ++rows_;
+        for (auto&& ix : indexes_)
+            indexRow(ix, rows_ - 1);
+    }
+
+    void addRow(std::vector<std::any>&& l) {
+        addRow(static_cast<const std::vector<std::any>&>(l));
+    }
+
+    void removeRow(std::size_t index) {
+        if (index >= rows_)
+            throw std::runtime_error("tabxx::CSV::removeRow(): Index out of range");
+        for (auto&& col : columns_)
+            col.erase(index, index + 1);
+        --rows_;
+        eraseIndexRows(index, index + 1);
+    }
+
+    // Removes rows [begin, end).
+    void removeRow(std::size_t begin, std::size_t end) {
+        if (begin > end || end > rows_)
+            throw std::runtime_error("tabxx::CSV::removeRow(): Invalid range");
+        if (begin == end)
+            return;
+        for (auto&& col : columns_)
+            col.erase(begin, end);
+        rows_ -= end - begin;
+        eraseIndexRows(begin, end);
+    }
+
+    // Removes every row i with mask[i] set in a single compaction pass, keeping
+    // the order of the rest; mask must have one entry per row. Returns the
+    // number of rows removed.
+    std::size_t removeRowsByMask(const std::vector<bool>& mask) {
+        if (mask.size() != rows_)
+            throw std::runtime_error("tabxx::CSV::removeRowsByMask(): Invalid mask size");
+        std::size_t n = static_cast<std::size_t>(std::count(mask.begin(), mask.end(), true));
+        if (n != 0) {
+            for (auto&& col : columns_)
+                col.erase(mask);
+            rows_ -= n;
+            eraseIndexRows(mask);
+        }
+        return n;
+    }
+
+    // Removes the listed rows, in any order and possibly repeated.
+    std::size_t removeRows(const std::vector<std::size_t>& rows) {
+        std::vector<bool> mask(rows_);
+        for (auto r : rows) {
+            if (r >= rows_)
+                throw std::runtime_error("tabxx::CSV::removeRows(): Index out of range");
+            mask[r] = true;
+        }
+        return removeRowsByMask(mask);
+    }
+
+    // Removes every row for which pred(row) returns true in a single compaction
+    // pass and returns the number of rows removed.
+    template <typename F>
+    std::size_t removeIf(F&& pred) {
+        std::vector<bool> mask(rows_);
+        for (std::size_t i = 0; i < rows_; ++i)
+            mask[i] = static_cast<bool>(pred(i));
+        return removeRowsByMask(mask);
+    }
+
+    // Drops every row from n on; does nothing if the table has at most n rows.
+    void truncate(std::size_t n) {
+        if (n >= rows_)
+            return;
+        for (auto&& col : columns_)
+            col.truncate(n);
+        eraseIndexRows(n, rows_);
+        rows_ = n;
+    }
+
+    // Makes room for `rows` rows in every column.
+    void reserve(std::size_t rows) {
+        for (auto&& col : columns_)
+            col.reserve(rows);
+    }
+
+    // Adds the rows in order after checking all of them, so a row with the
+    // wrong number of values leaves the table unchanged.
+    void appendRows(const std::vector<std::vector<std::any>>& rows) {
+        for (auto&& l : rows)
+            if (l.size() != title_.size())
+                throw std::runtime_error("tabxx::CSV::appendRows(): Invalid value count");
+        const std::size_t first = rows_;
+        reserve(rows_ + rows.size());
+        for (auto&& l : rows)
+            for (std::size_t i = 0; i < l.size(); ++i)
+                columns_[i].push(l[i]);
+        rows_ += rows.size();
+        indexRows(first);
+    }
+
+    // Adds the rows of a table with the same titles (adopted by a table
+    // without titles), column by column. Zero-copy views of `other` stay
+    // valid as long as this table.
+    void appendRows(const CSV& other) {
+        CSV copy(other);
+        appendRows(std::move(copy));
+    }
+
+    void appendRows(CSV&& other) {
+        if (title_.empty() && rows_ == 0)
+            setTitle(other.title_);
+        if (other.title_ != title_)
+            throw std::runtime_error("tabxx::CSV::appendRows(): Titles differ");
+        const std::size_t first = rows_;
+        for (std::size_t i = 0; i < columns_.size(); ++i)
+            columns_[i].append(std::move(other.columns_[i]));
+        rows_ += other.rows_;
+        if (other.source_) {
+            if (source_)
+                source_ = std::make_shared<std::pair<std::shared_ptr<const void>, std::shared_ptr<const void>>>(
+                    std::move(source_), std::move(other.source_));
+            else
+                source_ = std::move(other.source_);
+        }
+        other.rows_ = 0;
+        other.indexes_.clear();
+        indexRows(first);
+    }
+
+    // Parses the complete records in [data, data + size) and appends them to
+    // this table, reading the title line first if there is none yet. Returns
+    // the number of bytes consumed; the remainder is a partial record to pass
+    // again in front of the next chunk. `last` marks the end of the input.
+    // Strings are always copied, as the chunks need not outlive the table.
+    std::size_t append(const char* data, std::size_t size, bool last = false) {
+        const char* p = data;
+        const std::size_t rows = rows_;
+        transient_ = true;
+        try {
+            if (title_.empty()) {
+                p = parseTitle(data, data + size, last);
+                if (p == nullptr || title_.empty()) {
+                    transient_ = false;
+                    return p == nullptr ? 0 : static_cast<std::size_t>(p - data);
+                }
+            }
+            p = parseData(p, data + size, last);
+        }
+        catch (...) {
+            transient_ = false;
+            throw;
+        }
+        transient_ = false;
+        indexRows(rows);
+        return static_cast<std::size_t>(p - data);
+    }
+
+    std::size_t append(const std::string& data, bool last = false) {
+        return append(data.data(), data.size(), last);
+    }
+
+    Summary summarize(std::size_t column) const {
+        return columns_.at(column).summarize();
+    }
+
+    Summary summarize(const std::string& column) {
+        return summarize(searchTitle(column));
+    }
+
+    // Groups rows by equal values of the key columns, in order of first
+    // appearance, and returns one row per group: the keys followed by one
+    // "op(column)" result per aggregate. COUNT counts non-null cells of any
+    // column; the others need numeric columns and keep integers integral,
+    // except MEAN. Groups without non-null values get null.
+    CSV groupBy(const std::vector<std::string>& keys,
+                const std::vector<std::pair<std::string, AGGREGATE>>& aggregates) {
+        std::vector<std::size_t> key;
+        for (auto&& k : keys)
+            key.push_back(searchTitle(k));
+
+        std::vector<std::size_t> group(rows_);
+        std::vector<std::size_t> first; // representative row of each group
+        std::unordered_map<std::uint64_t, std::vector<std::size_t>> buckets;
+        for (std::size_t r = 0; r < rows_; ++r) {
+            std::uint64_t h = 0;
+            for (auto k : key)
+                h = (h ^ hashCell(columns_[k], r)) * 0x100000001b3ULL;
+            std::vector<std::size_t>& bucket = buckets[h];
+            std::size_t g = SIZE_MAX;
+            for (auto candidate : bucket) {
+                bool same = true;
+                for (std::size_t i = 0; same && i < key.size(); ++i)
+                    same = sameCell(columns_[key[i]], first[candidate], r);
+                if (same) {
+                    g = candidate;
+                    break;
+                }
+            }
+            if (g == SIZE_MAX) {
+                g = first.size();
+                first.push_back(r);
+                bucket.push_back(g);
+            }
+            group[r] = g;
+        }
+
+        static const char* const names[] = {"count", "sum", "min", "max", "mean"};
+        std::vector<std::string> title(keys);
+        for (auto&& a : aggregates)
+            title.push_back(std::string(names[a.second]) + "(" + a.first + ")");
+        Settings settings(settings_);
+        settings.clearSchema().clearSelection().setRowFilter(nullptr);
+        CSV ret(settings);
+        ret.setTitle(std::move(title));
+        for (std::size_t i = 0; i < key.size(); ++i) {
+            const Column& src = columns_[key[i]];
+            Column& des = ret.columns_[i];
+            for (auto r : first)
+                copyCell(src, r, des);
+        }
+        for (std::size_t i = 0; i < aggregates.size(); ++i) {
+            const Column& src = columns_[searchTitle(aggregates[i].first)];
+            Column& des = ret.columns_[key.size() + i];
+            AGGREGATE op = aggregates[i].second;
+            if (op == COUNT || src.getType() == Column::NONE)
+                aggregateGroups(src, static_cast<const long long*>(nullptr), group, first.size(), op, des);
+            else if (src.getType() == Column::DOUBLE)
+                aggregateGroups(src, src.doubles_.data(), group, first.size(), op, des);
+            else if (src.isDerived()) {
+                // Integers stay integral unless some cell derives to a double.
+                std::vector<long long> ints(rows_, 0);
+                std::vector<double> doubles(rows_, 0);
+                bool real = false;
+                for (std::size_t r = 0; r < rows_; ++r) {
+                    if (src.isNull(r))
+                        continue;
+                    const Column::Converted& c = src.derive(r);
+                    if (c.type == Column::INT)
+                        doubles[r] = static_cast<double>(ints[r] = c.i);
+                    else if (c.type == Column::DOUBLE) {
+                        doubles[r] = c.d;
+                        real = true;
+                    }
+                    else
+                        throw std::bad_any_cast();
+                }
+                if (real)
+                    aggregateGroups(src, doubles.data(), group, first.size(), op, des);
+                else
+                    aggregateGroups(src, ints.data(), group, first.size(), op, des);
+            }
+            else
+                aggregateGroups(src, src.ints(0, src.size()).data(), group, first.size(), op, des);
+        }
+        ret.rows_ = first.size();
+        return ret;
+    }
+
+    // Builds an index on a column, kept up to date by addRow(), append(),
+    // setValue() and row removal until dropIndex() or clear(). Null cells are
+    // not indexed; integers and doubles compare by numeric value.
+    void createIndex(const std::string& column, INDEX kind = HASH) {
+        std::size_t c = searchTitle(column);
+        for (auto&& ix : indexes_)
+            if (ix.column == c && ix.kind == kind)
+                return;
+        ColumnIndex ix{c, kind, {}, {}};
+        if (kind == HASH) {
+            for (std::size_t r = 0; r < rows_; ++r)
+                indexRow(ix, r);
+        }
+        else {
+            const Column& col = columns_[c];
+            for (std::size_t r = 0; r < rows_; ++r)
+                if (!col.isNull(r))
+                    ix.order.push_back(r);
+            std::stable_sort(ix.order.begin(), ix.order.end(), [&](std::size_t a, std::size_t b) {
+                return compareKeys(keyOf(col, a), keyOf(col, b)) < 0;
+            });
+        }
+        indexes_.push_back(std::move(ix));
+    }
+
+    void dropIndex(const std::string& column) {
+        std::size_t c = searchTitle(column);
+        indexes_.erase(std::remove_if(indexes_.begin(), indexes_.end(),
+                                      [&](const ColumnIndex& ix) { return ix.column == c; }), indexes_.end());
+    }
+
+    bool hasIndex(const std::string& column, INDEX kind) {
+        std::size_t c = searchTitle(column);
+        return findIndex(c, kind) != nullptr;
+    }
+
+    // Rows whose cell equals v (null cells for an empty v), in ascending row
+    // order. Uses an index on the column if there is one, otherwise scans.
+    std::vector<std::size_t> findRows(const std::string& column, const std::any& v) {
+        std::size_t c = searchTitle(column);
+        const Column& col = columns_[c];
+        std::vector<std::size_t> ret;
+        if (!v.has_value()) {
+            for (std::size_t r = 0; r < rows_; ++r)
+                if (col.isNull(r))
+                    ret.push_back(r);
+            return ret;
+        }
+        IndexKey key = keyOf(v);
+        if (const ColumnIndex* ix = findIndex(c, HASH)) {
+            auto ite = ix->buckets.find(hashKey(key));
+            if (ite != ix->buckets.end())
+                for (auto r : ite->second)
+                    if (compareKeys(keyOf(col, r), key) == 0)
+                        ret.push_back(r);
+            std::sort(ret.begin(), ret.end());
+        }
+        else if (const ColumnIndex* sorted = findIndex(c, SORTED)) {
+            auto range = equalRange(*sorted, key, key);
+            ret.assign(range.first, range.second);
+            std::sort(ret.begin(), ret.end());
+        }
+        else if (col.getType() == Column::DICT) {
+            // One dictionary lookup, then a scan of the codes.
+            long long code = key.kind == IndexKey::TEXT ? col.findCode(key.text) : -1;
+            if (code >= 0)
+                for (std::size_t r = 0; r < rows_; ++r)
+                    if (col.ints_[r] == code && !col.isNull(r))
+                        ret.push_back(r);
+        }
+        else {
+            for (std::size_t r = 0; r < rows_; ++r)
+                if (!col.isNull(r) && compareKeys(keyOf(col, r), key) == 0)
+                    ret.push_back(r);
+        }
+        return ret;
+    }
+
+    // Rows whose cell lies in [lo, hi], ordered by value, then by row.
+    std::vector<std::size_t> findRange(const std::string& column, const std::any& lo, const std::any& hi) {
+        std::size_t c = searchTitle(column);
+        IndexKey a = keyOf(lo);
+        IndexKey b = keyOf(hi);
+        if (const ColumnIndex* ix = findIndex(c, SORTED)) {
+            auto range = equalRange(*ix, a, b);
+            return std::vector<std::size_t>(range.first, range.second);
+        }
+        const Column& col = columns_[c];
+        std::vector<std::size_t> ret;
+        for (std::size_t r = 0; r < rows_; ++r)
+            if (!col.isNull(r) && compareKeys(keyOf(col, r), a) >= 0 && compareKeys(keyOf(col, r), b) <= 0)
+                ret.push_back(r);
+        std::stable_sort(ret.begin(), ret.end(), [&](std::size_t x, std::size_t y) {
+            return compareKeys(keyOf(col, x), keyOf(col, y)) < 0;
+        });
+        return ret;
+    }
+
+    bool hasTitle(const std::string& str) {
+        return index_.find(str) != index_.end();
+    }
+
+    std::size_t searchTitle(const std::string& str) {
+        auto ite = index_.find(str);
+        if (ite == index_.end())
+            throw std::runtime_error("tabxx::CSV::searchTitle(): Unknown column " + str);
+        return ite->second;
+    }
+
+    bool empty() {
+        return title_.empty();
+    }
+
+    void clear() {
+        title_.clear();
+        index_.clear();
+        input_index_.clear();
+        projection_.clear();
+        width_ = 0;
+        indexes_.clear();
+        columns_.clear();
+        arena_.ptr.reset();
+        rows_ = 0;
+        source_.reset();
+    }
+
+    Settings& settings() {
+        return settings_;
+    }
+
+    // Saves titles, column types and cell data in a binary form that
+    // loadSnapshot() reads back without parsing. VIEW columns are stored as
+    // text. Returns the number of bytes written.
+    std::size_t writeSnapshot(Writer& des) {
+        std::size_t start = des.size();
+        Checksum sum;
+        auto put = [&](const void* p, std::size_t n) {
+            des.put(std::string_view(static_cast<const char*>(p), n));
+            sum.update(p, n);
+        };
+        auto putWord = [&](std::uint64_t v) {
+            put(&v, sizeof(v));
+        };
+        auto pad = [&](std::size_t n) {
+            static const char zeros[8] = {};
+            put(zeros, (8 - n % 8) % 8);
+        };
+        SnapshotHeader h{{'T', 'A', 'B', 'X', 'X', 'S', 'N', 'P'}, SNAPSHOT_VERSION, SNAPSHOT_BYTE_ORDER, rows_, columns_.size()};
+        put(&h, sizeof(h));
+        std::vector<std::uint64_t> offsets;
+        std::string text;
+        // n strings as n + 1 offsets and the text; f(i, text) appends string i.
+        auto putStrings = [&](std::size_t n, auto&& f) {
+            offsets.assign(1, 0);
+            text.clear();
+            for (std::size_t i = 0; i < n; ++i) {
+                f(i, text);
+                offsets.push_back(text.size());
+            }
+            put(offsets.data(), offsets.size() * 8);
+            put(text.data(), text.size());
+            pad(text.size());
+        };
+        for (std::size_t j = 0; j < columns_.size(); ++j) {
+            const Column& col = columns_[j];
+            putWord(title_[j].size());
+            put(title_[j].data(), title_[j].size());
+            pad(title_[j].size());
+            Column::TYPE t = col.getType();
+            if (t == Column::VIEW)
+                t = Column::STRING;
+            putWord(t);
+            putWord(col.lazy_ ? SNAPSHOT_LAZY : 0);
+            std::vector<std::uint64_t> valid((rows_ + 63) / 64, 0);
+            std::copy(col.valid_.begin(), col.valid_.begin() + std::min(valid.size(), col.valid_.size()), valid.begin());
+            put(valid.data(), valid.size() * 8);
+            switch (t) {
+            case Column::BOOL:
+            case Column::INT32:
+            case Column::INT:
+            case Column::DATE:
+                put(col.ints_.data(), rows_ * sizeof(long long));
+                break;
+            case Column::DOUBLE:
+                put(col.doubles_.data(), rows_ * sizeof(double));
+                break;
+            case Column::STRING:
+                putStrings(rows_, [&](std::size_t i, std::string& out) {
+                    out.append(col.getString(i));
+                });
+                break;
+            case Column::DICT:
+                put(col.ints_.data(), rows_ * sizeof(long long));
+                putWord(col.getDictionarySize());
+                putStrings(col.getDictionarySize(), [&](std::size_t i, std::string& out) {
+                    out.append(col.dict_->values[i]);
+                });
+                break;
+            case Column::ANY: {
+                // Per cell its type, a 64-bit number and a text; types without
+                // a slot of their own are stored as their text.
+                std::vector<char> tags(rows_);
+                std::vector<std::uint64_t> cells(rows_, 0);
+                for (std::size_t i = 0; i < rows_; ++i) {
+                    const std::any& v = col.anys_[i];
+                    Column::TYPE c = col.isNull(i) ? Column::NONE : Column::typeOf(v);
+                    if (c == Column::DOUBLE)
+                        std::memcpy(&cells[i], std::any_cast<double>(&v), 8);
+                    else if (c == Column::BOOL || c == Column::INT32 || c == Column::INT || c == Column::DATE)
+                        cells[i] = static_cast<std::uint64_t>(Column::integerOf(c, v));
+                    else if (c == Column::ANY)
+                        c = Column::STRING;
+                    tags[i] = static_cast<char>(c);
+                }
+                put(tags.data(), rows_);
+                pad(rows_);
+                put(cells.data(), rows_ * 8);
+                putStrings(rows_, [&](std::size_t i, std::string& out) {
+                    if (tags[i] == Column::STRING || tags[i] == Column::VIEW)
+                        out += anyToString(col.anys_[i]);
+                });
+                break;
+            }
+            default:
+                break;
+            }
+        }
+        std::uint64_t check = sum.value();
+        des.put(std::string_view(reinterpret_cast<const char*>(&check), sizeof(check)));
+        return des.size() - start;
+    }
+
+    std::size_t writeSnapshot(const std::string& path) {
+        std::ofstream ofs(path, std::ios::binary);
+        if (!ofs)
+            throw std::runtime_error("tabxx::CSV::writeSnapshot(): Cannot open " + path);
+        Writer w(ofs);
+        std::size_t ret = writeSnapshot(w);
+        w.flush();
+        return ret;
+    }
+
+    std::size_t write(std::ostream& des) {
+        Writer w(des);
+        std::size_t ret = write(w);
+        w.flush();
+        return ret;
+    }
+
+    std::size_t write(Writer& des) {
+        if (empty())
+            return 0;
+        std::size_t ret = writeTitle(des);
+        return ret + writeRows(des, 0, rows_);
+    }
+
+    std::size_t writeTitle(Writer& des) {
+        std::size_t start = des.size();
+        for (std::size_t i = 0; i < title_.size(); ++i) {
+            if (i != 0)
+                des.put(settings_.separator_);
+            writeText(des, title_[i]);
+        }
+        writeEnding(des);
+        return des.size() - start;
+    }
+
+    // Writes rows [begin, end) without the title line. With several threads
+    // (Settings::setThreadCount()), consecutive row ranges of about
+    // setChunkSize() bytes are formatted concurrently and written in order.
+    std::size_t writeRows(Writer& des, std::size_t begin, std::size_t end) {
+        if (begin > end || end > rows_)
+            throw std::runtime_error("tabxx::CSV::writeRows(): Invalid range");
+        std::size_t start = des.size();
+        const unsigned threads = settings_.threadCount();
+        if (threads <= 1 || end - begin <= 2 * WRITE_SAMPLE_ROWS) {
+            formatRows(des, begin, end);
+            return des.size() - start;
+        }
+        // The first rows are written directly and size the ranges.
+        std::size_t i = begin + WRITE_SAMPLE_ROWS;
+        formatRows(des, begin, i);
+        const std::size_t row_bytes = std::max<std::size_t>(1, (des.size() - start) / WRITE_SAMPLE_ROWS);
+        const std::size_t step = std::max<std::size_t>(1, settings_.chunk_size_ / row_bytes);
+        std::vector<std::string> parts(threads);
+        while (i < end) {
+            runParallel(parts.size(), threads, [&](std::size_t k) {
+                std::size_t b = std::min(end, i + k * step);
+                parts[k].clear();
+                Writer w(parts[k]);
+                formatRows(w, b, std::min(end, b + step));
+                w.flush();
+            });
+            for (auto&& part : parts)
+                des.put(part);
+            i = std::min(end, i + parts.size() * step);
+        }
+        return des.size() - start;
+    }
+
+private:
+    static constexpr std::size_t WRITE_SAMPLE_ROWS = 1024;
+
+    void formatRows(Writer& des, std::size_t begin, std::size_t end) const {
+        for (std::size_t i = begin; i < end; ++i) {
+            for (std::size_t j = 0; j < columns_.size(); ++j) {
+                if (j != 0)
+                    des.put(settings_.separator_);
+                writeCell(des, columns_[j], i);
+            }
+            writeEnding(des);
+        }
+    }
+
+    void writeEnding(Writer& des) const {
+        if (settings_.ending_ == Settings::LF)
+            des.put('\n');
+        else
+            des.put(std::string_view("\r\n", 2));
+    }
+
+    void writeCell(Writer& des, const Column& col, std::size_t row) const {
+        if (col.isNull(row))
+            return;
+        switch (col.getType()) {
+        case Column::BOOL:
+            des.put(col.ints_[row] ? std::string_view("true") : std::string_view("false"));
+            break;
+        case Column::INT32:
+        case Column::INT:
+            des.putInt(col.ints_[row]);
+            break;
+        case Column::DATE: {
+            char buf[16];
+            des.put(std::string_view(buf, Date::fromDays(col.ints_[row]).format(buf) - buf));
+            break;
+        }
+        case Column::DOUBLE:
+            des.putDouble(col.doubles_[row], settings_.double_precision_);
+            break;
+        case Column::STRING:
+        case Column::VIEW:
+        case Column::DICT:
+            writeText(des, col.getString(row));
+            break;
+        default: {
+            const std::any& v = col.anys_[row];
+            if (v.type() == typeid(long long))
+                des.putInt(std::any_cast<long long>(v));
+            else if (v.type() == typeid(double))
+                des.putDouble(std::any_cast<double>(v), settings_.double_precision_);
+            else if (v.type() == typeid(std::string_view))
+                writeText(des, std::any_cast<std::string_view>(v));
+            else
+                writeText(des, anyToString(v));
+            break;
+        }
+        }
+    }
+
+    // Quotes v (RFC 4180) only if it holds a separator, quote or line break.
+    void writeText(Writer& des, std::string_view v) const {
+        bool quote = false;
+        for (char c : v)
+            quote |= (c == settings_.separator_) | (c == '"') | (c == '\n') | (c == '\r');
+        if (!quote) {
+            des.put(v);
+            return;
+        }
+        des.put('"');
+        for (std::size_t i; (i = v.find('"')) != std::string_view::npos; ) {
+            des.put(v.substr(0, i + 1));
+            des.put('"');
+            v.remove_prefix(i + 1);
+        }
+        des.put(v);
+        des.put('"');
+    }
+
+    // Skips a leading '+', which from_chars() does not take; a second sign
+    // after it ("+-5") is rejected.
+    static bool skipPlus(const char*& b, const char* e) {
+        if (b != e && *b == '+' && ++b != e && (*b == '+' || *b == '-'))
+            return false;
+        return true;
+    }
+
+    template <typename I>
+    static bool parseInt(const char* b, const char* e, I& v) {
+        if (!skipPlus(b, e))
+            return false;
+        auto r = std::from_chars(b, e, v);
+        return r.ec == std::errc() && r.ptr == e;
+    }
+
+    static bool parseDouble(const char* b, const char* e, double& v) {
+        if (!skipPlus(b, e))
+            return false;
+#ifdef __cpp_lib_to_chars
+        auto r = std::from_chars(b, e, v, std::chars_format::general);
+        return r.ec == std::errc() && r.ptr == e;
+#else
+        char buf[128];
+        std::size_t n = static_cast<std::size_t>(e - b);
+        if (n >= sizeof(buf))
+            return false;
+        std::memcpy(buf, b, n);
+        buf[n] = '\0';
+        char* end = nullptr;
+        v = std::strtod(buf, &end);
+        return end == buf + n;
+#endif
+    }
+
+    // Writes v in fixed notation into [first, last); returns nullptr if it does not fit.
+    static char* formatDouble(char* first, char* last, double v, int precision) {
+#ifdef __cpp_lib_to_chars
+        auto r = std::to_chars(first, last, v, std::chars_format::fixed, precision);
+        return r.ec == std::errc() ? r.ptr : nullptr;
+#else
+        int n = std::snprintf(first, last - first, "%.*f", precision, v);
+        return (n >= 0 && n < last - first) ? first + n : nullptr;
+#endif
+    }
+
+    template <typename I>
+    static std::string integerToString(I v) {
+        char buf[24];
+        return std::string(buf, std::to_chars(buf, buf + sizeof(buf), v).ptr);
+    }
+
+    std::string doubleToString(double v) const {
+        char buf[128];
+        if (char* e = formatDouble(buf, buf + sizeof(buf), v, settings_.double_precision_))
+            return std::string(buf, e);
+        std::string ret(std::numeric_limits<double>::max_exponent10 + settings_.double_precision_ + 8, '\0');
+        ret.resize(formatDouble(&ret[0], &ret[0] + ret.size(), v, settings_.double_precision_) - ret.data());
+        return ret;
+    }
+
+    Column::TYPE detectType(Column& col, std::string_view str) {
+        if (str.empty()) {
+            col.pushNull();
+            return Column::NONE;
+        }
+        const char* b = str.data();
+        const char* e = b + str.size();
+        const char* d = (b != e && (*b == '+' || *b == '-')) ? b + 1 : b;
+        if (d != e && (('0' <= *d && *d <= '9') || *d == '.')) {
+            long long i;
+            if (parseInt(b, e, i)) { // INT (long long)
+                col.pushInt(i);
+                return Column::INT;
+            }
+            double f;
+            if (parseDouble(b, e, f)) { // FLOAT (double)
+                col.pushDouble(f);
+                return Column::DOUBLE;
+            }
+        }
+        pushText(col, str); // STRING (std::string)
+        return Column::STRING;
+    }
+
+    std::string anyToString(const std::any& v) const {
+        if (v.type() == typeid(std::string))
+            return std::any_cast<const std::string&>(v);
+        if (v.type() == typeid(std::string_view))
+            return std::string(std::any_cast<std::string_view>(v));
+        if (v.type() == typeid(double))
+            return doubleToString(std::any_cast<double>(v));
+        if (v.type() == typeid(long long))
+            return integerToString(std::any_cast<long long>(v));
+        if (v.type() == typeid(int))
+            return integerToString(std::any_cast<int>(v));
+        if (v.type() == typeid(short))
+            return integerToString(std::any_cast<short>(v));
+        if (v.type() == typeid(char))
+            return integerToString(static_cast<int>(std::any_cast<char>(v)));
+        if (v.type() == typeid(bool))
+            return std::any_cast<bool>(v) ? "true" : "false";
+        if (v.type() == typeid(Date)) {
+            char buf[16];
+            return std::string(buf, std::any_cast<const Date&>(v).format(buf));
+        }
+        throw std::runtime_error("tabxx::CSV::anyToString(): Unsupported type");
+    }
+
+    static const char* skipLineEnd(const char* e, const char* end) {
+        if (e != end && *e++ == '\r' && e != end && *e == '\n')
+            ++e;
+        return e;
+    }
+
+    // A line is complete once its terminator is seen; a trailing '\r' might
+    // still be followed by '\n' in the next block.
+    static bool lineComplete(const char* e, const char* end, bool last) {
+        return last || (e != end && !(*e == '\r' && e + 1 == end));
+    }
+
+    static bool parseBool(std::string_view str, bool& v) {
+        auto is = [&](std::string_view word) {
+            if (str.size() != word.size())
+                return false;
+            for (std::size_t i = 0; i < word.size(); ++i)
+                if ((str[i] | 0x20) != word[i])
+                    return false;
+            return true;
+        };
+        if (str == "1" || is("true"))
+            v = true;
+        else if (str == "0" || is("false"))
+            v = false;
+        else
+            return false;
+        return true;
+    }
+
+    void convertField(std::size_t column, std::string_view v) {
+        Column& col = columns_[column];
+        const ColumnSchema& sc = schema_[column];
+        if (v.empty() && (sc.nullable || (sc.type != Settings::STRING && sc.type != Settings::DICTIONARY))) {
+            if (!sc.nullable)
+                throw std::runtime_error("tabxx::CSV::parse(): Empty value in non-nullable column " + title_[column]);
+            col.pushNull();
+            return;
+        }
+        if (sc.type == Settings::STRING) {
+            pushText(col, v);
+            return;
+        }
+        if (sc.type == Settings::DICTIONARY) {
+            col.pushEncoded(v);
+            return;
+        }
+        const char* b = v.data();
+        const char* e = b + v.size();
+        bool ok = false;
+        switch (sc.type) {
+        case Settings::BOOL: {
+            bool x;
+            if ((ok = parseBool(v, x)))
+                col.pushBool(x);
+            break;
+        }
+        case Settings::INT32: {
+            int x;
+            if ((ok = parseInt(b, e, x)))
+                col.pushInt32(x);
+            break;
+        }
+        case Settings::INT64: {
+            long long x;
+            if ((ok = parseInt(b, e, x)))
+                col.pushInt(x);
+            break;
+        }
+        case Settings::DOUBLE: {
+            double x;
+            if ((ok = parseDouble(b, e, x)))
+                col.pushDouble(x);
+            break;
+        }
+        case Settings::DATE: {
+            Date x{};
+            if ((ok = Date::parse(v, x)))
+                col.pushDate(x);
+            break;
+        }
+        default:
+            break;
+        }
+        if (!ok)
+            throw std::runtime_error("tabxx::CSV::parse(): Cannot convert \"" + std::string(v) + "\" in column " + title_[column]);
+    }
+
+    void pushField(std::size_t column, std::string_view v) {
+        if (!schema_.empty() && schema_[column].declared) {
+            convertField(column, v);
+            return;
+        }
+        Column& col = columns_[column];
+        if (settings_.lazy_)
+            pushLazy(col, v);
+        else if (settings_.auto_derive_type_) {
+            Column::TYPE t = detectType(col, v);
+            if (settings_.stats_ != nullptr)
+                ++settings_.stats_->types[column][t];
+        }
+        else
+            pushText(col, v);
+    }
+
+    // Zero-copy views must not point into unescaped_, which is reused per
+    // record, nor into append() chunks.
+    void pushText(Column& col, std::string_view v) {
+        if (!settings_.zero_copy_ || transient_)
+            col.pushString(v);
+        else if (!unescaped_.empty() && !std::less<const char*>()(v.data(), unescaped_.data()) &&
+                 std::less<const char*>()(v.data(), unescaped_.data() + unescaped_.size()))
+            col.pushView(col.own(v));
+        else
+            col.pushView(v);
+    }
+
+    // Duplicate titles resolve to their first occurrence.
+    void indexTitle() {
+        index_.clear();
+        index_.reserve(title_.size());
+        for (std::size_t i = 0; i < title_.size(); ++i)
+            index_.emplace(title_[i], i);
+        resizeColumns(title_.size());
+        schema_.clear();
+        if (settings_.schema_.empty())
+            return;
+        schema_.assign(title_.size(), ColumnSchema{false, Settings::STRING, true});
+        // Names and indices refer to the input; entries for columns that are
+        // not selected are ignored.
+        const auto& names = projection_.empty() ? index_ : input_index_;
+        for (auto&& entry : settings_.schema_) {
+            std::size_t i = entry.index;
+            if (i == SIZE_MAX) {
+                auto ite = names.find(entry.name);
+                if (ite == names.end())
+                    throw std::runtime_error("tabxx::CSV::Settings::setColumnType(): Unknown column " + entry.name);
+                i = ite->second;
+            }
+            if (!projection_.empty()) {
+                auto ite = std::find(projection_.begin(), projection_.end(), i);
+                if (ite == projection_.end())
+                    continue;
+                i = static_cast<std::size_t>(ite - projection_.begin());
+            }
+            if (i >= title_.size())
+                throw std::runtime_error("tabxx::CSV::Settings::setColumnType(): Column index out of range");
+            schema_[i] = ColumnSchema{true, entry.type, entry.nullable};
+        }
+    }
+
+    // Returns the position after the title line, or nullptr if more input is needed.
+    const char* parseTitle(const char* p, const char* end, bool last) {
+        const char* e = nullptr;
+        const char* next = tokenize(p, end, last, [&](std::vector<std::string_view>&, const char*, const char* c) {
+            e = c;
+            return true;
+        });
+        if (e == nullptr) {
+            if (!last)
+                return nullptr;
+            e = next = end; // empty input
+            fields_.assign(1, std::string_view());
+        }
+        if (settings_.ending_ == Settings::AUTO && e != end)
+            settings_.ending_ = (*e == '\r' ? Settings::CRLF : Settings::LF);
+        std::vector<std::string_view>& fields = fields_;
+        if (fields.back().empty())
+            fields.pop_back();
+        width_ = fields.size();
+        projection_.clear();
+        if (!settings_.selection_.empty()) {
+            std::vector<bool> selected(width_, false);
+            for (auto&& entry : settings_.selection_) {
+                std::size_t i = entry.index;
+                if (i == SIZE_MAX)
+                    i = static_cast<std::size_t>(std::find(fields.begin(), fields.end(), entry.name) - fields.begin());
+                if (i >= width_)
+                    throw std::runtime_error("tabxx::CSV::Settings::selectColumn(): Unknown column " +
+                                             (entry.index == SIZE_MAX ? entry.name : std::to_string(entry.index)));
+                selected[i] = true;
+            }
+            for (std::size_t i = 0; i < width_; ++i)
+                if (selected[i])
+                    projection_.push_back(i);
+        }
+        if (projection_.empty())
+            for (auto&& f : fields)
+                title_.emplace_back(f);
+        else {
+            for (auto i : projection_)
+                title_.emplace_back(fields[i]);
+            for (std::size_t i = 0; i < width_; ++i)
+                input_index_.emplace(fields[i], i);
+        }
+        indexTitle();
+        fields.clear();
+        unescaped_.clear();
+        return next;
+    }
+
+    // How fields become cells: TEXT, DERIVED and LAZY skip the per-field
+    // schema and stats checks of pushField(), DECLARED goes through it.
+    enum TYPING {TEXT, DERIVED, LAZY, DECLARED};
+
+    TYPING typing() const {
+        if (!schema_.empty() || settings_.stats_ != nullptr)
+            return DECLARED;
+        if (settings_.lazy_)
+            return LAZY;
+        return settings_.auto_derive_type_ ? DERIVED : TEXT;
+    }
+
+    // Returns false if the row filter rejected the record.
+    template <TYPING Typing>
+    bool pushRecord(const std::vector<std::string_view>& fields) {
+        if (fields.size() != width_)
+            throw std::runtime_error("tabxx::CSV::parse(): Invalid Dataline");
+        if (settings_.filter_ && !settings_.filter_(RecordView(this, &fields)))
+            return false;
+        if (projection_.empty())
+            for (std::size_t i = 0; i < fields.size(); ++i)
+                pushField<Typing>(i, fields[i]);
+        else
+            for (std::size_t i = 0; i < projection_.size(); ++i)
+                pushField<Typing>(i, fields[projection_[i]]);
+        ++rows_;
+        return true;
+    }
+
+    template <TYPING Typing>
+    void pushField(std::size_t column, std::string_view v) {
+        if constexpr (Typing == TEXT)
+            pushText(columns_[column], v);
+        else if constexpr (Typing == DERIVED)
+            detectType(columns_[column], v);
+        else if constexpr (Typing == LAZY)
+            pushLazy(columns_[column], v);
+        else
+            pushField(column, v);
+    }
+
+    void pushLazy(Column& col, std::string_view v) {
+        col.lazy_ = true;
+        if (v.empty())
+            col.pushNull();
+        else
+            pushText(col, v);
+    }
+
+    std::pmr::memory_resource* memoryResource() {
+        std::pmr::memory_resource* upstream = settings_.resource_ ? settings_.resource_ : std::pmr::get_default_resource();
+        if (!settings_.arena_)
+            return upstream;
+        if (!arena_.ptr)
+            arena_.ptr = std::make_shared<std::pmr::monotonic_buffer_resource>(upstream);
+        return arena_.ptr.get();
+    }
+
+    void resizeColumns(std::size_t n) {
+        if (n < columns_.size())
+            columns_.resize(n);
+        std::pmr::memory_resource* r = memoryResource();
+        while (columns_.size() < n)
+            columns_.emplace_back(r, arena_.ptr);
+    }
+
+    std::uint64_t hashCell(const Column& col, std::size_t row) {
+        if (col.isNull(row))
+            return 0x9e3779b97f4a7c15ULL;
+        if (col.isDerived()) {
+            const Column::Converted& c = col.derive(row);
+            if (c.type == Column::INT)
+                return std::hash<long long>()(c.i);
+            if (c.type == Column::DOUBLE)
+                return std::hash<double>()(c.d);
+        }
+        switch (col.getType()) {
+        case Column::BOOL:
+        case Column::INT32:
+        case Column::INT:
+        case Column::DATE:
+        case Column::DICT:
+            return std::hash<long long>()(col.ints_[row]);
+        case Column::DOUBLE:
+            return std::hash<double>()(col.doubles_[row]);
+        case Column::STRING:
+        case Column::VIEW:
+            return std::hash<std::string_view>()(col.getString(row));
+        default:
+            return std::hash<std::string>()(anyToString(col.anys_[row]));
+        }
+    }
+
+    bool sameCell(const Column& col, std::size_t a, std::size_t b) {
+        if (col.isNull(a) || col.isNull(b))
+            return col.isNull(a) == col.isNull(b);
+        if (col.isDerived()) {
+            Column::Converted x = col.derive(a);
+            Column::Converted y = col.derive(b);
+            if (x.type != y.type)
+                return false;
+            if (x.type == Column::INT)
+                return x.i == y.i;
+            if (x.type == Column::DOUBLE)
+                return x.d == y.d;
+        }
+        switch (col.getType()) {
+        case Column::BOOL:
+        case Column::INT32:
+        case Column::INT:
+        case Column::DATE:
+        case Column::DICT:
+            return col.ints_[a] == col.ints_[b];
+        case Column::DOUBLE:
+            return col.doubles_[a] == col.doubles_[b];
+        case Column::STRING:
+        case Column::VIEW:
+            return col.getString(a) == col.getString(b);
+        default:
+            return col.anys_[a].type() == col.anys_[b].type() && anyToString(col.anys_[a]) == anyToString(col.anys_[b]);
+        }
+    }
+
+    // The type a column needs to hold cells of types a and b: mixed numbers
+    // widen, other mismatches need ANY.
+    static Column::TYPE unifyTypes(Column::TYPE a, Column::TYPE b) {
+        if (a == b || b == Column::NONE)
+            return a;
+        if (a == Column::NONE)
+            return b;
+        if (Column::isNumeric(a) && Column::isNumeric(b))
+            return a == Column::DOUBLE || b == Column::DOUBLE ? Column::DOUBLE : Column::INT;
+        return Column::ANY;
+    }
+
+    // t must come from unifyTypes() over the column's own type.
+    static void retype(Column& col, Column::TYPE t) {
+        col.prepare(t);
+    }
+
+    // Strings are copied so the result does not depend on this table's input.
+    static void copyCell(const Column& src, std::size_t row, Column& des) {
+        if (src.isNull(row)) {
+            des.pushNull();
+            return;
+        }
+        switch (src.getType()) {
+        case Column::BOOL:
+        case Column::INT32:
+        case Column::INT:
+        case Column::DATE:
+            des.pushInteger(src.getType(), src.ints_[row]);
+            break;
+        case Column::DOUBLE:
+            des.pushDouble(src.doubles_[row]);
+            break;
+        case Column::STRING:
+        case Column::VIEW:
+            des.pushString(src.getString(row));
+            break;
+        case Column::DICT:
+            des.pushEncoded(src.getString(row));
+            break;
+        default:
+            des.push(src.anys_[row]);
+            break;
+        }
+    }
+
+    template <typename T>
+    static void aggregateGroups(const Column& src, const T* v, const std::vector<std::size_t>& group,
+                                std::size_t groups, AGGREGATE op, Column& des) {
+        std::vector<std::size_t> count(groups, 0);
+        std::vector<T> acc(groups, op == MINIMUM ? std::numeric_limits<T>::max() :
+                                   op == MAXIMUM ? std::numeric_limits<T>::lowest() : T(0));
+        for (std::size_t r = 0; r < group.size(); ++r) {
+            if (!((src.valid_[r >> 6] >> (r & 63)) & 1))
+                continue;
+            std::size_t g = group[r];
+            ++count[g];
+            switch (op) {
+            case SUM:
+            case MEAN:
+                acc[g] += v[r];
+                break;
+            case MINIMUM:
+                acc[g] = std::min(acc[g], v[r]);
+                break;
+            case MAXIMUM:
+                acc[g] = std::max(acc[g], v[r]);
+                break;
+            default:
+                break;
+            }
+        }
+        for (std::size_t g = 0; g < groups; ++g) {
+            if (op == COUNT)
+                des.pushInt(static_cast<long long>(count[g]));
+            else if (count[g] == 0)
+                des.pushNull();
+            else if (op == MEAN)
+                des.pushDouble(static_cast<double>(acc[g]) / static_cast<double>(count[g]));
+            else if constexpr (std::is_same_v<T, double>)
+                des.pushDouble(acc[g]);
+            else
+                des.pushInt(acc[g]);
+        }
+    }
+
+    static constexpr std::uint32_t SNAPSHOT_VERSION = 2;
+    static constexpr std::uint32_t SNAPSHOT_BYTE_ORDER = 0x01020304;
+    static constexpr std::uint64_t SNAPSHOT_LAZY = 1; // column flag: Column::isLazy()
+
+    // Snapshot layout, every part padded to 8 bytes: this header; per column
+    // the title (length, bytes), the type, the flags (since version 2), the
+    // validity bitmap and the data (64-bit cells, row offsets plus text for
+    // strings, codes plus the entry count, offsets and text of a dictionary,
+    // or for ANY per-cell types, 64-bit cells and texts); finally a checksum
+    // of everything before it.
+    struct SnapshotHeader {
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t byte_order;
+        std::uint64_t rows;
+        std::uint64_t columns;
+    };
+
+    // Fast 64-bit hash for detecting corrupt or truncated snapshots.
+    class Checksum {
+    public:
+        Checksum() : hash_(0x9e3779b97f4a7c15ULL), tail_(0), length_(0) {}
+
+        void update(const void* data, std::size_t n) {
+            const unsigned char* p = static_cast<const unsigned char*>(data);
+            for (; n != 0 && (length_ & 7) != 0; --n)
+                push(*p++);
+            for (; n >= 8; n -= 8, p += 8, length_ += 8) {
+                std::uint64_t w;
+                std::memcpy(&w, p, 8);
+                mix(w);
+            }
+            for (; n != 0; --n)
+                push(*p++);
+        }
+
+        std::uint64_t value() const {
+            Checksum c(*this);
+            if ((c.length_ & 7) != 0)
+                c.mix(c.tail_);
+            c.mix(c.length_);
+            return c.hash_;
+        }
+
+    private:
+        void push(unsigned char c) {
+            tail_ |= std::uint64_t(c) << (8 * (length_ & 7));
+            if ((++length_ & 7) == 0) {
+                mix(tail_);
+                tail_ = 0;
+            }
+        }
+
+        void mix(std::uint64_t w) {
+            hash_ ^= w * 0xbf58476d1ce4e5b9ULL;
+            hash_ = ((hash_ << 31) | (hash_ >> 33)) * 0x94d049bb133111ebULL;
+        }
+
+        std::uint64_t hash_;
+        std::uint64_t tail_;
+        std::uint64_t length_;
+
+    }; // class Checksum
+
+    void readSnapshot(const char* data, std::size_t size) {
+        static const char* const truncated = "tabxx::CSV::loadSnapshot(): Truncated snapshot";
+        SnapshotHeader h;
+        if (size < sizeof(h) + 8)
+            throw std::runtime_error(truncated);
+        std::memcpy(&h, data, sizeof(h));
+        if (std::memcmp(h.magic, "TABXXSNP", 8) != 0)
+            throw std::runtime_error("tabxx::CSV::loadSnapshot(): Not a snapshot");
+        if (h.byte_order != SNAPSHOT_BYTE_ORDER)
+            throw std::runtime_error("tabxx::CSV::loadSnapshot(): Byte order mismatch");
+        if (h.version != 1 && h.version != SNAPSHOT_VERSION)
+            throw std::runtime_error("tabxx::CSV::loadSnapshot(): Unsupported version " + std::to_string(h.version));
+        Checksum sum;
+        sum.update(data, size - 8);
+        std::uint64_t check;
+        std::memcpy(&check, data + size - 8, 8);
+        if (check != sum.value())
+            throw std::runtime_error("tabxx::CSV::loadSnapshot(): Checksum mismatch");
+
+        const char* p = data + sizeof(h);
+        const char* end = data + size - 8;
+        auto take = [&](std::size_t n) {
+            std::size_t padded = n + (8 - n % 8) % 8;
+            if (padded < n || static_cast<std::size_t>(end - p) < padded)
+                throw std::runtime_error(truncated);
+            const char* ret = p;
+            p += padded;
+            return ret;
+        };
+        auto word = [&]() {
+            std::uint64_t v;
+            std::memcpy(&v, take(8), 8);
+            return v;
+        };
+        struct Strings {
+            const char* offsets;
+            std::string_view text;
+        };
+        auto takeStrings = [&](std::size_t n) {
+            const char* offsets = take((n + 1) * 8);
+            std::uint64_t last;
+            std::memcpy(&last, offsets + n * 8, 8);
+            if (last > SIZE_MAX)
+                throw std::runtime_error(truncated);
+            const char* text = take(static_cast<std::size_t>(last));
+            return Strings{offsets, std::string_view(text, static_cast<std::size_t>(last))};
+        };
+        auto piece = [&](const Strings& s, std::size_t i) {
+            std::uint64_t a, b;
+            std::memcpy(&a, s.offsets + i * 8, 8);
+            std::memcpy(&b, s.offsets + (i + 1) * 8, 8);
+            if (a > b || b > s.text.size())
+                throw std::runtime_error(truncated);
+            return s.text.substr(static_cast<std::size_t>(a), static_cast<std::size_t>(b - a));
+        };
+        if (h.rows > SIZE_MAX / 16)
+            throw std::runtime_error(truncated);
+        const std::size_t rows = static_cast<std::size_t>(h.rows);
+        const std::size_t words = (rows + 63) / 64;
+        std::vector<std::string> title;
+        std::vector<Column> columns;
+        for (std::uint64_t j = 0; j < h.columns; ++j) {
+            std::size_t n = static_cast<std::size_t>(word());
+            title.emplace_back(take(n), n);
+            Column col(memoryResource(), arena_.ptr);
+            std::uint64_t t = word();
+            col.type_ = static_cast<Column::TYPE>(t);
+            col.lazy_ = h.version >= 2 && (word() & SNAPSHOT_LAZY);
+            col.size_ = rows;
+            const char* valid = take(words * 8);
+            col.valid_.resize(words);
+            std::memcpy(col.valid_.data(), valid, words * 8);
+            switch (t) {
+            case Column::BOOL:
+            case Column::INT32:
+            case Column::INT:
+            case Column::DATE: {
+                const char* ints = take(rows * 8);
+                col.ints_.resize(rows);
+                std::memcpy(col.ints_.data(), ints, rows * 8);
+                break;
+            }
+            case Column::DOUBLE: {
+                const char* doubles = take(rows * 8);
+                col.doubles_.resize(rows);
+                std::memcpy(col.doubles_.data(), doubles, rows * 8);
+                break;
+            }
+            case Column::STRING: {
+                Strings s = takeStrings(rows);
+                if (settings_.zero_copy_) {
+                    col.type_ = Column::VIEW;
+                    col.views_.resize(rows);
+                }
+                else {
+                    col.blob_.assign(s.text.data(), s.text.size());
+                    col.spans_.resize(rows);
+                }
+                for (std::size_t i = 0; i < rows; ++i) {
+                    std::string_view v = piece(s, i);
+                    if (settings_.zero_copy_)
+                        col.views_[i] = v;
+                    else
+                        col.spans_[i] = Column::Span{static_cast<std::size_t>(v.data() - s.text.data()), v.size()};
+                }
+                break;
+            }
+            case Column::DICT: {
+                if (h.version < 2)
+                    throw std::runtime_error("tabxx::CSV::loadSnapshot(): Unknown column type");
+                const char* codes = take(rows * 8);
+                std::uint64_t entries = word();
+                if (entries >= SIZE_MAX / 8)
+                    throw std::runtime_error(truncated);
+                Strings s = takeStrings(static_cast<std::size_t>(entries));
+                col.ints_.resize(rows);
+                std::memcpy(col.ints_.data(), codes, rows * 8);
+                for (std::size_t i = 0; i < rows; ++i)
+                    if (!col.isNull(i) && static_cast<std::uint64_t>(col.ints_[i]) >= entries)
+                        throw std::runtime_error("tabxx::CSV::loadSnapshot(): Invalid dictionary code");
+                col.dict_ = std::make_shared<Column::Dictionary>();
+                for (std::size_t c = 0; c < entries; ++c) {
+                    col.dict_->values.emplace_back(piece(s, c));
+                    col.dict_->codes.emplace(col.dict_->values.back(), static_cast<long long>(c));
+                }
+                break;
+            }
+            case Column::ANY: {
+                if (h.version < 2)
+                    throw std::runtime_error("tabxx::CSV::loadSnapshot(): Unknown column type");
+                const char* tags = take(rows);
+                const char* cells = take(rows * 8);
+                Strings s = takeStrings(rows);
+                col.anys_.resize(rows);
+                for (std::size_t i = 0; i < rows; ++i) {
+                    Column::TYPE c = static_cast<Column::TYPE>(tags[i]);
+                    long long v;
+                    std::memcpy(&v, cells + i * 8, 8);
+                    switch (c) {
+                    case Column::NONE:
+                        break;
+                    case Column::BOOL:
+                    case Column::INT32:
+                    case Column::INT:
+                    case Column::DATE:
+                        col.anys_[i] = Column::box(c, v);
+                        break;
+                    case Column::DOUBLE: {
+                        double d;
+                        std::memcpy(&d, cells + i * 8, 8);
+                        col.anys_[i] = d;
+                        break;
+                    }
+                    case Column::STRING:
+                        col.anys_[i] = std::string(piece(s, i));
+                        break;
+                    case Column::VIEW:
+                        if (settings_.zero_copy_)
+                            col.anys_[i] = piece(s, i);
+                        else
+                            col.anys_[i] = std::string(piece(s, i));
+                        break;
+                    default:
+                        throw std::runtime_error("tabxx::CSV::loadSnapshot(): Unknown cell type");
+                    }
+                }
+                break;
+            }
+            case Column::NONE:
+                break;
+            default:
+                throw std::runtime_error("tabxx::CSV::loadSnapshot(): Unknown column type");
+            }
+            columns.push_back(std::move(col));
+        }
+        title_ = std::move(title);
+        width_ = title_.size();
+        columns_ = std::move(columns);
+        rows_ = rows;
+        indexTitle();
+    }
+
+    // A non-null cell reduced to a number or a text for indexing.
+    struct IndexKey {
+        enum {INTEGER, REAL, TEXT} kind;
+        long long integer;
+        double real;
+        std::string_view text;
+        std::string owned; // text of cells without a native string form
+    };
+
+    struct ColumnIndex {
+        std::size_t column;
+        INDEX kind;
+        std::unordered_map<std::uint64_t, std::vector<std::size_t>> buckets; // HASH
+        std::vector<std::size_t> order; // SORTED, by value, then by row
+    };
+
+    IndexKey keyOf(const std::any& v) {
+        IndexKey k{IndexKey::TEXT, 0, 0, std::string_view(), std::string()};
+        Column::TYPE t = Column::typeOf(v);
+        if (t == Column::BOOL || t == Column::INT32 || t == Column::INT || t == Column::DATE) {
+            k.kind = IndexKey::INTEGER;
+            k.integer = Column::integerOf(t, v);
+        }
+        else if (t == Column::DOUBLE) {
+            k.kind = IndexKey::REAL;
+            k.real = std::any_cast<double>(v);
+        }
+        else if (t == Column::STRING)
+            k.text = std::any_cast<const std::string&>(v);
+        else if (t == Column::VIEW)
+            k.text = std::any_cast<std::string_view>(v);
+        else if (v.type() == typeid(const char*))
+            k.text = std::any_cast<const char*>(v);
+        else if (v.type() == typeid(short) || v.type() == typeid(char)) {
+            k.kind = IndexKey::INTEGER;
+            k.integer = v.type() == typeid(short) ? std::any_cast<short>(v) : std::any_cast<char>(v);
+        }
+        else {
+            k.owned = anyToString(v);
+            k.text = k.owned;
+        }
+        return k;
+    }
+
+    IndexKey keyOf(const Column& col, std::size_t row) {
+        IndexKey k{IndexKey::INTEGER, 0, 0, std::string_view(), std::string()};
+        if (col.isDerived()) {
+            const Column::Converted& c = col.derive(row);
+            if (c.type == Column::INT) {
+                k.integer = c.i;
+                return k;
+            }
+            if (c.type == Column::DOUBLE) {
+                k.kind = IndexKey::REAL;
+                k.real = c.d;
+                return k;
+            }
+        }
+        switch (col.getType()) {
+        case Column::BOOL:
+        case Column::INT32:
+        case Column::INT:
+        case Column::DATE:
+            k.integer = col.ints_[row];
+            return k;
+        case Column::DOUBLE:
+            k.kind = IndexKey::REAL;
+            k.real = col.doubles_[row];
+            return k;
+        case Column::STRING:
+        case Column::VIEW:
+        case Column::DICT:
+            k.kind = IndexKey::TEXT;
+            k.text = col.getString(row);
+            return k;
+        default:
+            return keyOf(col.anys_[row]);
+        }
+    }
+
+    // Numbers order before texts.
+    static int compareKeys(const IndexKey& a, const IndexKey& b) {
+        if ((a.kind == IndexKey::TEXT) != (b.kind == IndexKey::TEXT))
+            return a.kind == IndexKey::TEXT ? 1 : -1;
+        if (a.kind == IndexKey::TEXT)
+            return a.text.compare(b.text);
+        if (a.kind == IndexKey::INTEGER && b.kind == IndexKey::INTEGER)
+            return a.integer < b.integer ? -1 : (b.integer < a.integer ? 1 : 0);
+        double x = a.kind == IndexKey::INTEGER ? static_cast<double>(a.integer) : a.real;
+        double y = b.kind == IndexKey::INTEGER ? static_cast<double>(b.integer) : b.real;
+        return x < y ? -1 : (y < x ? 1 : 0);
+    }
+
+    // Integral doubles hash like the equal integer.
+    static std::uint64_t hashKey(const IndexKey& k) {
+        if (k.kind == IndexKey::TEXT)
+            return std::hash<std::string_view>()(k.text);
+        if (k.kind == IndexKey::REAL) {
+            if (k.real >= -9.2e18 && k.real <= 9.2e18 && static_cast<double>(static_cast<long long>(k.real)) == k.real)
+                return std::hash<long long>()(static_cast<long long>(k.real));
+            return std::hash<double>()(k.real);
+        }
+        return std::hash<long long>()(k.integer);
+    }
+
+    const ColumnIndex* findIndex(std::size_t column, INDEX kind) const {
+        for (auto&& ix : indexes_)
+            if (ix.column == column && ix.kind == kind)
+                return &ix;
+        return nullptr;
+    }
+
+    std::pair<std::vector<std::size_t>::const_iterator, std::vector<std::size_t>::const_iterator>
+    equalRange(const ColumnIndex& ix, const IndexKey& lo, const IndexKey& hi) {
+        const Column& col = columns_[ix.column];
+        auto b = std::lower_bound(ix.order.begin(), ix.order.end(), lo, [&](std::size_t r, const IndexKey& k) {
+            return compareKeys(keyOf(col, r), k) < 0;
+        });
+        auto e = std::upper_bound(b, ix.order.end(), hi, [&](const IndexKey& k, std::size_t r) {
+            return compareKeys(k, keyOf(col, r)) < 0;
+        });
+        return std::make_pair(b, e);
+    }
+
+    // Adds `row` to ix; rows are expected to come in ascending order within equal values.
+    void indexRow(ColumnIndex& ix, std::size_t row) {
+        const Column& col = columns_[ix.column];
+        if (col.isNull(row))
+            return;
+        IndexKey key = keyOf(col, row);
+        if (ix.kind == HASH) {
+            std::vector<std::size_t>& bucket = ix.buckets[hashKey(key)];
+            bucket.insert(std::upper_bound(bucket.begin(), bucket.end(), row), row);
+            return;
+        }
+        auto ite = std::upper_bound(ix.order.begin(), ix.order.end(), row, [&](std::size_t r, std::size_t x) {
+            int c = compareKeys(key, keyOf(col, x));
+            return c < 0 || (c == 0 && r < x);
+        });
+        ix.order.insert(ite, row);
+    }
+
+    void unindexRow(ColumnIndex& ix, std::size_t row) {
+        const Column& col = columns_[ix.column];
+        if (col.isNull(row))
+            return;
+        IndexKey key = keyOf(col, row);
+        if (ix.kind == HASH) {
+            std::vector<std::size_t>& bucket = ix.buckets[hashKey(key)];
+            bucket.erase(std::remove(bucket.begin(), bucket.end(), row), bucket.end());
+            return;
+        }
+        auto range = equalRange(ix, key, key);
+        auto ite = std::find(range.first, range.second, row);
+        if (ite != range.second)
+            ix.order.erase(ite);
+    }
+
+    // Adds rows [first, rows_) to every index.
+    void indexRows(std::size_t first) {
+        for (auto&& ix : indexes_)
+            for (std::size_t r = first; r < rows_; ++r)
+                indexRow(ix, r);
+    }
+
+    // Drops rows [begin, end) from the indexes and renumbers the rows after them.
+    void eraseIndexRows(std::size_t begin, std::size_t end) {
+        auto update = [&](std::vector<std::size_t>& v) {
+            std::size_t n = 0;
+            for (auto r : v)
+                if (r < begin || r >= end)
+                    v[n++] = r < begin ? r : r - (end - begin);
+            v.resize(n);
+        };
+        for (auto&& ix : indexes_) {
+            update(ix.order);
+            for (auto&& b : ix.buckets)
+                update(b.second);
+        }
+    }
+
+    void eraseIndexRows(const std::vector<bool>& mask) {
+        if (indexes_.empty())
+            return;
+        std::vector<std::size_t> remap(mask.size());
+        std::size_t kept = 0;
+        for (std::size_t r = 0; r < mask.size(); ++r)
+            remap[r] = mask[r] ? SIZE_MAX : kept++;
+        auto update = [&](std::vector<std::size_t>& v) {
+            std::size_t n = 0;
+            for (auto r : v)
+                if (remap[r] != SIZE_MAX)
+                    v[n++] = remap[r];
+            v.resize(n);
+        };
+        for (auto&& ix : indexes_) {
+            update(ix.order);
+            for (auto&& b : ix.buckets)
+                update(b.second);
+        }
+    }
+
+    // Resolves a name against the input header rather than the kept columns.
+    std::size_t searchInput(const std::string& str) {
+        if (projection_.empty())
+            return searchTitle(str);
+        auto ite = input_index_.find(str);
+        if (ite == input_index_.end())
+            throw std::runtime_error("tabxx::CSV::searchTitle(): Unknown column " + str);
+        return ite->second;
+    }
+
+    // Gives a parallel parse task the same column layout as this table.
+    void copyLayout(CSV& part) const {
+        part.title_ = title_;
+        part.index_ = index_;
+        part.input_index_ = input_index_;
+        part.schema_ = schema_;
+        part.projection_ = projection_;
+        part.width_ = width_;
+        part.transient_ = transient_;
+        part.resizeColumns(columns_.size());
+    }
+
+    // Splits [p, end) into records, honouring RFC 4180 quotes, and calls
+    // f(fields, line, line_end) for each complete one until f returns true.
+    // Returns the position after the last record handed to f.
+    template <typename F>
+    const char* tokenize(const char* p, const char* end, bool last, F&& f) {
+        if (settings_.ending_ == Settings::LF)
+            return tokenize<Settings::LF>(p, end, last, std::forward<F>(f));
+        return tokenize<Settings::AUTO>(p, end, last, std::forward<F>(f));
+    }
+
+    // With Ending == LF every match is a complete "\n" line end, so the
+    // "\r\n" handling drops out; any other Ending follows settings_.ending_.
+    template <Settings::LINE_ENDING Ending, typename F>
+    const char* tokenize(const char* p, const char* end, bool last, F&& f) {
+        const char sep = settings_.separator_;
+        Scanner scanner(sep,
+                        Ending != Settings::LF && settings_.ending_ == Settings::CRLF ? '\r' : '\n',
+                        Ending == Settings::LF || settings_.ending_ == Settings::LF ? '\n' : '\r');
+        std::vector<std::string_view>& fields = fields_;
+        fields.clear();
+        unescaped_.clear();
+        escapes_.clear();
+        const char* line = p;
+        const char* field = p;
+        std::uint64_t inside = 0;
+        std::uint64_t carry = Scanner::FIELD_START;
+        for (const char* block = p; block < end; block += Scanner::BLOCK_SIZE) {
+            Scanner::Block b = scanner.scan(block, static_cast<std::size_t>(end - block));
+            std::uint64_t m = (b.separator | b.ending) & ~scanner.fieldQuoteMask(b, inside, carry);
+            for (; m != 0; m &= m - 1) {
+                const char* c = block + Scanner::trailingZeros(m);
+                if (Ending != Settings::LF && c < field)
+                    continue; // '\n' of a "\r\n" pair
+                pushToken(field, c);
+                if (*c == sep) {
+                    field = c + 1;
+                    continue;
+                }
+                if (Ending != Settings::LF && !lineComplete(c, end, last))
+                    return line;
+                resolveEscapes();
+                bool stop = f(fields, line, c);
+                line = field = (Ending == Settings::LF ? c + 1 : skipLineEnd(c, end));
+                if (stop)
+                    return line;
+                fields.clear();
+                unescaped_.clear();
+                escapes_.clear();
+            }
+        }
+        if (line == end || !last)
+            return line;
+        pushToken(field, end);
+        resolveEscapes();
+        f(fields, line, end);
+        return end;
+    }
+
+    // Adds [b, e) to fields_, stripping the quotes of a quoted field. Fields
+    // with escaped quotes are unescaped into unescaped_ by resolveEscapes().
+    void pushToken(const char* b, const char* e) {
+        if (b == e || *b != '"') {
+            fields_.emplace_back(b, e - b);
+            return;
+        }
+        if (e - b < 2 || e[-1] != '"')
+            throw std::runtime_error("tabxx::CSV::parse(): Invalid quoted field");
+        const char* q = static_cast<const char*>(std::memchr(b + 1, '"', e - b - 2));
+        if (q == nullptr) {
+            fields_.emplace_back(b + 1, e - b - 2);
+            return;
+        }
+        std::size_t start = unescaped_.size();
+        for (++b, --e; ; ) {
+            if (q + 1 == e || q[1] != '"')
+                throw std::runtime_error("tabxx::CSV::parse(): Invalid quoted field");
+            unescaped_.append(b, q + 1);
+            b = q + 2;
+            q = static_cast<const char*>(std::memchr(b, '"', e - b));
+            if (q == nullptr)
+                break;
+        }
+        unescaped_.append(b, e);
+        escapes_.push_back(Escape{fields_.size(), start, unescaped_.size() - start});
+        fields_.emplace_back();
+    }
+
+    // Points unescaped fields at their final storage once the record is complete.
+    void resolveEscapes() {
+        for (auto&& x : escapes_)
+            fields_[x.field] = std::string_view(unescaped_.data() + x.offset, x.length);
+    }
+
+    // Parses up to `limit` complete lines in [p, end) and returns where parsing stopped.
+    const char* parseRows(const char* p, const char* end, bool last, std::size_t limit = SIZE_MAX) {
+        if (limit == 0)
+            return p;
+        ParseStats* stats = settings_.stats_;
+        if (stats == nullptr) {
+            const bool lf = settings_.ending_ == Settings::LF;
+            switch (typing()) {
+            case TEXT:
+                return lf ? parseRows<Settings::LF, TEXT>(p, end, last, limit) :
+                            parseRows<Settings::AUTO, TEXT>(p, end, last, limit);
+            case DERIVED:
+                return lf ? parseRows<Settings::LF, DERIVED>(p, end, last, limit) :
+                            parseRows<Settings::AUTO, DERIVED>(p, end, last, limit);
+            case LAZY:
+                return lf ? parseRows<Settings::LF, LAZY>(p, end, last, limit) :
+                            parseRows<Settings::AUTO, LAZY>(p, end, last, limit);
+            default:
+                return lf ? parseRows<Settings::LF, DECLARED>(p, end, last, limit) :
+                            parseRows<Settings::AUTO, DECLARED>(p, end, last, limit);
+            }
+        }
+
+        if (stats->types.size() < columns_.size())
+            stats->types.resize(columns_.size(), std::vector<std::uint64_t>(Column::ANY + 1));
+        auto start = std::chrono::steady_clock::now();
+        std::chrono::steady_clock::duration convert(0);
+        const char* ret = tokenize(p, end, last, [&](std::vector<std::string_view>& fields, const char* line, const char* c) {
+            if (c == line && c != end)
+                throw std::runtime_error("tabxx::CSV::parse(): Invalid Dataline (Empty Line)");
+            auto t = std::chrono::steady_clock::now();
+            bool stored = pushRecord<DECLARED>(fields);
+            convert += std::chrono::steady_clock::now() - t;
+            stats->fields += fields.size();
+            ++(stored ? stats->rows : stats->filtered);
+            return stored && --limit == 0;
+        });
+        fields_.clear();
+        unescaped_.clear();
+        auto total = std::chrono::steady_clock::now() - start;
+        stats->bytes += static_cast<std::uint64_t>(ret - p);
+        stats->tokenize_ns += nanoseconds(total - convert);
+        stats->convert_ns += nanoseconds(convert);
+        return ret;
+    }
+
+    // parseRows() specialized for a line ending and typing mode.
+    template <Settings::LINE_ENDING Ending, TYPING Typing>
+    const char* parseRows(const char* p, const char* end, bool last, std::size_t limit) {
+        const char* ret = tokenize<Ending>(p, end, last, [&](std::vector<std::string_view>& fields, const char* line, const char* c) {
+            if (c == line && c != end)
+                throw std::runtime_error("tabxx::CSV::parse(): Invalid Dataline (Empty Line)");
+            return pushRecord<Typing>(fields) && --limit == 0;
+        });
+        fields_.clear();
+        unescaped_.clear();
+        return ret;
+    }
+
+    static std::uint64_t nanoseconds(std::chrono::steady_clock::duration d) {
+        return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(d).count());
+    }
+
+    // Times a parse phase: adds the elapsed time to the `total` counter of
+    // the stats and reports the span to the trace hook, if either is set.
+    class Timer {
+    public:
+        Timer(const Settings& settings, const char* name, std::uint64_t ParseStats::* total = nullptr) :
+            settings_(settings),
+            name_(name),
+            total_(settings.stats_ != nullptr ? total : nullptr),
+            enabled_(total_ != nullptr || settings.trace_) {
+            if (enabled_)
+                start_ = std::chrono::steady_clock::now();
+        }
+
+        Timer(const Timer&) = delete;
+        Timer& operator=(const Timer&) = delete;
+
+        ~Timer() {
+            if (!enabled_)
+                return;
+            auto end = std::chrono::steady_clock::now();
+            if (total_ != nullptr)
+                settings_.stats_->*total_ += nanoseconds(end - start_);
+            if (settings_.trace_)
+                settings_.trace_(name_, start_, end);
+        }
+
+    private:
+        const Settings& settings_;
+        const char* name_;
+        std::uint64_t ParseStats::* total_;
+        bool enabled_;
+        std::chrono::steady_clock::time_point start_;
+
+    }; // class Timer
+
+    // Runs f(0) ... f(tasks - 1) on up to `threads` threads and rethrows the
+    // exception of the lowest failing task.
+    template <typename F>
+    static void runParallel(std::size_t tasks, unsigned threads, F&& f) {
+        std::vector<std::exception_ptr> errors(tasks);
+        std::atomic<std::size_t> next(0);
+        auto worker = [&]() {
+            for (std::size_t i; (i = next.fetch_add(1)) < tasks; ) {
+                try {
+                    f(i);
+                }
+                catch (...) {
+                    errors[i] = std::current_exception();
+                }
+            }
+        };
+        std::vector<std::thread> pool;
+        for (unsigned i = 1; i < threads && i < tasks; ++i)
+            pool.emplace_back(worker);
+        worker();
+        for (auto&& t : pool)
+            t.join();
+        for (auto&& e : errors)
+            if (e)
+                std::rethrow_exception(e);
+    }
+
+    // Finds the first line ending in [p, e) outside quotes, for both possible
+    // quote states at p (even: outside, odd: inside). Bit s of `ends` is the
+    // state at e when starting in state s.
+    void findRecordStart(const char* begin, const char* p, const char* e, const char*& even, const char*& odd,
+                         unsigned& ends) const {
+        Scanner scanner(settings_.separator_,
+                        settings_.ending_ == Settings::CRLF ? '\r' : '\n',
+                        settings_.ending_ == Settings::LF ? '\n' : '\r');
+        even = odd = nullptr;
+        std::uint64_t inside[2] = {0, ~std::uint64_t(0)};
+        std::uint64_t carry[2];
+        carry[0] = carry[1] = (p == begin ? Scanner::FIELD_START : scanner.carryAt(begin, p));
+        for (const char* block = p; block < e; block += Scanner::BLOCK_SIZE) {
+            const Scanner::Block b = scanner.scan(block, static_cast<std::size_t>(e - block));
+            for (int s = 0; s < 2; ++s) {
+                Scanner::Block q = b;
+                std::uint64_t m = b.ending & ~scanner.fieldQuoteMask(q, inside[s], carry[s]);
+                const char*& first = (s == 0 ? even : odd);
+                if (first == nullptr && m != 0)
+                    first = block + Scanner::trailingZeros(m);
+            }
+        }
+        ends = static_cast<unsigned>(inside[0] & 1) | static_cast<unsigned>(inside[1] & 1) << 1;
+    }
+
+    // Cuts [p, end) at record boundaries roughly every chunk_size_ bytes;
+    // returns the cut points including p and end.
+    std::vector<const char*> splitChunks(const char* p, const char* end, unsigned threads) const {
+        Timer timer(settings_, "csv.split", &ParseStats::tokenize_ns);
+        const std::size_t chunk = settings_.chunk_size_;
+        const std::size_t count = (static_cast<std::size_t>(end - p) + chunk - 1) / chunk;
+        if (count <= 1)
+            return std::vector<const char*>{p, end};
+        std::vector<const char*> even(count), odd(count);
+        std::vector<unsigned> ends(count);
+        runParallel(count, threads, [&](std::size_t i) {
+            const char* b = p + i * chunk;
+            findRecordStart(p, b, b + std::min<std::size_t>(chunk, end - b), even[i], odd[i], ends[i]);
+        });
+        std::vector<const char*> bounds{p};
+        unsigned state = ends[0] & 1;
+        for (std::size_t i = 1; i < count; ++i) {
+            const char* c = state ? odd[i] : even[i];
+            if (c != nullptr) {
+                const char* next = skipLineEnd(c, end);
+                if (next != end)
+                    bounds.push_back(next);
+            }
+            state = (ends[i] >> state) & 1;
+        }
+        bounds.push_back(end);
+        return bounds;
+    }
+
+    // Same contract as parseRows(), splitting [p, end) into chunks that are
+    // tokenized concurrently and appended in order.
+    const char* parseData(const char* p, const char* end, bool last) {
+        const unsigned threads = settings_.threadCount();
+        const std::size_t chunk = settings_.chunk_size_;
+        const std::size_t size = static_cast<std::size_t>(end - p);
+        Timer timer(settings_, "csv.parse");
+        if (threads <= 1 || size < 2 * chunk || settings_.ending_ == Settings::AUTO)
+            return parseRows(p, end, last);
+
+        std::vector<const char*> bounds = splitChunks(p, end, threads);
+
+        // Each chunk counts into its own stats, merged once all are done.
+        std::vector<CSV> parts(bounds.size() - 1, CSV(settings_));
+        std::vector<ParseStats> local(settings_.stats_ != nullptr ? parts.size() : 0);
+        for (std::size_t i = 0; i < local.size(); ++i)
+            parts[i].settings_.stats_ = &local[i];
+        std::vector<const char*> stops(parts.size());
+        runParallel(parts.size(), threads, [&](std::size_t i) {
+            Timer span(parts[i].settings_, "csv.chunk");
+            copyLayout(parts[i]);
+            stops[i] = parts[i].parseRows(bounds[i], bounds[i + 1], last || i + 1 < parts.size());
+        });
+        for (auto&& x : local)
+            settings_.stats_->merge(x);
+        Timer merge(settings_, "csv.merge", &ParseStats::merge_ns);
+        runParallel(columns_.size(), threads, [&](std::size_t j) {
+            for (auto&& part : parts)
+                columns_[j].append(std::move(part.columns_[j]));
+        });
+        for (auto&& part : parts)
+            rows_ += part.rows_;
+        return stops.back();
+    }
+
+    int parseBuffer(const char* data, std::size_t size) {
+        clear();
+        const char* p = parseTitle(data, data + size, true);
+        if (title_.empty())
+            return -1;
+        parseData(p, data + size, true);
+        return 0;
+    }
+
+    int parse(std::istream& src) {
+        if (settings_.zero_copy_) {
+            std::shared_ptr<std::string> buf;
+            {
+                Timer timer(settings_, "csv.read", &ParseStats::io_ns);
+                buf = std::make_shared<std::string>(std::istreambuf_iterator<char>(src), std::istreambuf_iterator<char>());
+            }
+            int ret = parseBuffer(buf->data(), buf->size());
+            source_ = std::move(buf);
+            return ret;
+        }
+        return scan(src, [&](const char* p, const char* end, bool last) {
+            return parseData(p, end, last);
+        });
+    }
+
+    // Reads src block by block, parses the title and hands the data to
+    // g(p, end, last), which returns where it stopped.
+    template <typename G>
+    int scan(std::istream& src, G&& g) {
+        clear();
+        std::string buf;
+        bool titled = false;
+        const std::size_t block = std::max(READ_BLOCK_SIZE, settings_.threadCount() > 1 ?
+                                           settings_.chunk_size_ * settings_.threadCount() : 0);
+        Prefetcher in(src, block, settings_.prefetch_);
+        for (bool last = false; !last; ) {
+            {
+                Timer timer(settings_, "csv.read", &ParseStats::io_ns);
+                last = !in.read(buf);
+            }
+            const char* p = buf.data();
+            const char* end = p + buf.size();
+            if (!titled) {
+                p = parseTitle(p, end, last);
+                if (p == nullptr)
+                    continue;
+                if (title_.empty())
+                    return -1;
+                titled = true;
+            }
+            p = g(p, end, last);
+            buf.erase(0, p - buf.data());
+        }
+        return 0;
+    }
+
+    // Column of each binding in a table of `width` columns; lookup(name)
+    // resolves named bindings.
+    template <typename Row, typename L>
+    static std::vector<std::size_t> resolve(const RowMapping<Row>& mapping, std::size_t width, L&& lookup) {
+        std::vector<std::size_t> ret;
+        ret.reserve(mapping.bindings_.size());
+        for (auto&& b : mapping.bindings_) {
+            std::size_t i = (b.index == SIZE_MAX ? lookup(b.name) : b.index);
+            if (i >= width)
+                throw std::out_of_range("tabxx::CSV::RowMapping::bind(): Column index out of range");
+            ret.push_back(i);
+        }
+        return ret;
+    }
+
+    // Same contract as parseRows(), converting each record into a Row for f
+    // instead of storing it. `columns` is resolved on the first call.
+    template <typename Row, typename F>
+    const char* mapRecords(const char* p, const char* end, bool last, const RowMapping<Row>& mapping,
+                           std::vector<std::size_t>& columns, F& f) {
+        if (columns.size() != mapping.bindings_.size())
+            columns = resolve(mapping, width_, [&](const std::string& name) {
+                return searchInput(name);
+            });
+        const char* ret = tokenize(p, end, last, [&](std::vector<std::string_view>& fields, const char* line, const char* c) {
+            if (c == line && c != end)
+                throw std::runtime_error("tabxx::CSV::parse(): Invalid Dataline (Empty Line)");
+            if (fields.size() != width_)
+                throw std::runtime_error("tabxx::CSV::parse(): Invalid Dataline");
+            if (settings_.filter_ && !settings_.filter_(RecordView(this, &fields)))
+                return false;
+            Row row{};
+            for (std::size_t k = 0; k < columns.size(); ++k)
+                if (!mapping.bindings_[k].field(row, fields[columns[k]]))
+                    throw std::runtime_error("tabxx::CSV::parse(): Cannot convert \"" + std::string(fields[columns[k]]) +
+                                             "\" in column " + std::to_string(columns[k]));
+            f(row);
+            return false;
+        });
+        fields_.clear();
+        unescaped_.clear();
+        return ret;
+    }
+
+    // Converts a field for a RowMapping member; empty fields leave non-text
+    // members untouched.
+    template <typename V>
+    static bool readField(std::string_view v, V& out) {
+        if constexpr (std::is_same_v<V, std::string_view>)
+            out = v;
+        else if constexpr (std::is_same_v<V, std::string>)
+            out.assign(v.data(), v.size());
+        else if (v.empty())
+            return true;
+        else if constexpr (std::is_same_v<V, bool>)
+            return parseBool(v, out);
+        else if constexpr (std::is_same_v<V, Date>)
+            return Date::parse(v, out);
+        else if constexpr (std::is_floating_point_v<V>) {
+            double d;
+            if (!parseDouble(v.data(), v.data() + v.size(), d))
+                return false;
+            out = static_cast<V>(d);
+        }
+        else
+            return parseInt(v.data(), v.data() + v.size(), out);
+        return true;
+    }
+
+    // Reads a cell for a RowMapping member. Text cells are converted, integer
+    // cells fit any arithmetic member and double cells floating-point ones
+    // (integral members too if the value is whole); other mismatches throw
+    // std::bad_any_cast.
+    template <typename V>
+    static void readCell(const Column& c, std::size_t i, V& out) {
+        if (c.isNull(i))
+            return;
+        switch (c.type_) {
+        case Column::BOOL:
+        case Column::INT32:
+        case Column::INT:
+            if constexpr (std::is_arithmetic_v<V>) {
+                out = static_cast<V>(c.ints_[i]);
+                return;
+            }
+            break;
+        case Column::DOUBLE:
+            if constexpr (std::is_floating_point_v<V>) {
+                out = static_cast<V>(c.doubles_[i]);
+                return;
+            }
+            else if constexpr (std::is_integral_v<V> && !std::is_same_v<V, bool>) {
+                long long x;
+                if (Column::wholeNumber(c.doubles_[i], x)) {
+                    out = static_cast<V>(x);
+                    return;
+                }
+            }
+            break;
+        case Column::DATE:
+            if constexpr (std::is_same_v<V, Date>) {
+                out = Date::fromDays(c.ints_[i]);
+                return;
+            }
+            break;
+        case Column::STRING:
+        case Column::VIEW:
+        case Column::DICT:
+            if (!readField(c.getString(i), out))
+                throw std::runtime_error("tabxx::CSV::forEachRow(): Cannot convert \"" + std::string(c.getString(i)) + "\"");
+            return;
+        case Column::ANY: {
+            const std::any& a = c.anys_[i];
+            if (a.type() == typeid(std::string) || a.type() == typeid(std::string_view)) {
+                std::string_view v = (a.type() == typeid(std::string) ? std::string_view(std::any_cast<const std::string&>(a)) :
+                                                                        std::any_cast<std::string_view>(a));
+                if (!readField(v, out))
+                    throw std::runtime_error("tabxx::CSV::forEachRow(): Cannot convert \"" + std::string(v) + "\"");
+                return;
+            }
+            if constexpr (std::is_arithmetic_v<V>) {
+                if (a.type() == typeid(long long)) {
+                    out = static_cast<V>(std::any_cast<long long>(a));
+                    return;
+                }
+            }
+            if constexpr (std::is_floating_point_v<V>) {
+                if (a.type() == typeid(double)) {
+                    out = static_cast<V>(std::any_cast<double>(a));
+                    return;
+                }
+            }
+            else if constexpr (std::is_integral_v<V> && !std::is_same_v<V, bool>) {
+                long long x;
+                if (a.type() == typeid(double) && Column::wholeNumber(std::any_cast<double>(a), x)) {
+                    out = static_cast<V>(x);
+                    return;
+                }
+            }
+            out = std::any_cast<V>(a);
+            return;
+        }
+        default:
+            break;
+        }
+        throw std::bad_any_cast();
+    }
+
+    static constexpr std::size_t READ_BLOCK_SIZE = 1 << 20;
+
+private:
+    Settings settings_;
+    std::vector<std::string> title_;
+    std::unordered_map<std::string, std::size_t> index_;
+    struct ColumnSchema {
+        bool declared;
+        Settings::COLUMN_TYPE type;
+        bool nullable;
+    };
+    std::vector<ColumnSchema> schema_; // resolved from Settings per title
+    std::vector<std::size_t> projection_; // input field of each column, empty if all are kept
+    std::size_t width_; // fields per input record
+    std::unordered_map<std::string, std::size_t> input_index_; // input titles, kept only with a projection
+    ResourceHolder arena_; // declared before columns_ so it outlives them
+    std::vector<Column> columns_;
+    std::vector<ColumnIndex> indexes_;
+    std::size_t rows_;
+    std::shared_ptr<const void> source_; // keeps zero-copy views valid
+    bool transient_; // input is not kept alive by source_
+    std::vector<std::string_view> fields_;
+    struct Escape {
+        std::size_t field;
+        std::size_t offset;
+        std::size_t length;
+    };
+    std::string unescaped_;
+    std::vector<Escape> escapes_;
+
+}; // class CSV
+
+// Reads one row at a time; only the current row and one input block are kept in memory.
+class CSV::Reader {
+public:
+    Reader(std::istream& src, const Settings& s = Settings()) :
+        table_(s), src_(&src), cur_(nullptr), end_(nullptr), eof_(false), row_(0) {
+        readTitle();
+    }
+
+    Reader(const char* data, std::size_t size, const Settings& s = Settings()) :
+        table_(s), src_(nullptr), cur_(data), end_(data + size), eof_(true), row_(0) {
+        readTitle();
+    }
+
+    Reader(const Reader&) = delete;
+    Reader& operator=(const Reader&) = delete;
+
+    // Advances to the next row; returns false once the input is exhausted.
+    bool next() {
+        for (auto&& col : table_.columns_)
+            col.reset();
+        table_.rows_ = 0;
+        if (table_.title_.empty())
+            return false;
+        for (; ; ) {
+            if (cur_ != end_ || eof_) {
+                cur_ = table_.parseRows(cur_, end_, eof_, 1);
+                if (table_.rows_ == 1) {
+                    ++row_;
+                    return true;
+                }
+                if (eof_)
+                    return false;
+            }
+            fill();
+        }
+    }
+
+    // Calls f(reader) for every remaining row and returns the number of rows visited.
+    template <typename F>
+    std::size_t forEach(F&& f) {
+        std::size_t n = 0;
+        for (; next(); ++n)
+            f(*this);
+        return n;
+    }
+
+    std::size_t getColumnCount() {
+        return table_.getColumnCount();
+    }
+
+    std::vector<std::string> getTitles() {
+        return table_.getTitles();
+    }
+
+    std::size_t searchTitle(const std::string& str) {
+        return table_.searchTitle(str);
+    }
+
+    bool hasTitle(const std::string& str) {
+        return table_.hasTitle(str);
+    }
+
+    // Number of rows read so far.
+    std::size_t getRowIndex() {
+        return row_;
+    }
+
+    std::vector<std::any> getRow() {
+        return table_.getRow(0);
+    }
+
+    // Storage of the current row; string views stay valid until next().
+    const Column& getColumnData(std::size_t column) {
+        return table_.getColumnData(column);
+    }
+
+    const std::any getValue(std::size_t column) {
+        return table_.getValue(column, 0);
+    }
+
+    template <typename V>
+    V getValue(std::size_t column) {
+        return table_.getValue<V>(column, 0);
+    }
+
+    const std::any getValue(const std::string& column) {
+        return table_.getValue(column, 0);
+    }
+
+    template <typename V>
+    V getValue(const std::string& column) {
+        return table_.getValue<V>(column, 0);
+    }
+
+    Settings& settings() {
+        return table_.settings();
+    }
+
+private:
+    void fill() {
+        buffer_.erase(0, cur_ - buffer_.data());
+        std::size_t n = buffer_.size();
+        buffer_.resize(n + READ_BLOCK_SIZE);
+        {
+            Timer timer(table_.settings_, "csv.read", &ParseStats::io_ns);
+            src_->read(&buffer_[n], READ_BLOCK_SIZE);
+        }
+        buffer_.resize(n + static_cast<std::size_t>(src_->gcount()));
+        eof_ = !*src_;
+        cur_ = buffer_.data();
+        end_ = cur_ + buffer_.size();
+    }
+
+    void readTitle() {
+        if (src_ != nullptr) {
+            cur_ = end_ = buffer_.data();
+            fill();
+        }
+        for (; ; ) {
+            const char* p = table_.parseTitle(cur_, end_, eof_);
+            if (p != nullptr) {
+                cur_ = p;
+                return;
+            }
+            fill();
+        }
+    }
+
+private:
+    CSV table_; // holds the title and the current row
+    std::istream* src_;
+    std::string buffer_;
+    const char* cur_;
+    const char* end_;
+    bool eof_;
+    std::size_t row_;
+
+}; // class CSV::Reader
+
+// Pipelined stream ingestion: one thread reads blocks ahead, another parses
+// them into batches of rows, which the caller takes in order with next().
+// The stream must outlive the reader.
+class CSV::BatchReader {
+public:
+    BatchReader(std::istream& src, const Settings& s = Settings(), std::size_t rows = 1 << 16) :
+        settings_(s), rows_(rows == 0 ? 1 : rows),
+        in_(src, READ_BLOCK_SIZE, std::max<std::size_t>(s.prefetch_, 1)),
+        batches_(std::max<std::size_t>(s.prefetch_, 1)), count_(0) {
+        thread_ = std::thread([this]() { run(); });
+    }
+
+    BatchReader(const BatchReader&) = delete;
+    BatchReader& operator=(const BatchReader&) = delete;
+
+    ~BatchReader() {
+        batches_.close();
+        in_.close();
+        thread_.join();
+    }
+
+    // Advances to the next batch of up to `rows` rows; returns false once
+    // the input is exhausted and rethrows any error of the pipeline.
+    bool next() {
+        std::unique_ptr<CSV> b;
+        if (!batches_.pop(b)) {
+            if (error_)
+                std::rethrow_exception(error_);
+            batch_.reset();
+            return false;
+        }
+        batch_ = std::move(b);
+        ++count_;
+        return true;
+    }
+
+    // The current batch, a table of its own that stays valid until next().
+    CSV& getBatch() {
+        if (!batch_)
+            throw std::runtime_error("tabxx::CSV::BatchReader::getBatch(): No current batch");
+        return *batch_;
+    }
+
+    // Number of batches read so far.
+    std::size_t getBatchIndex() {
+        return count_;
+    }
+
+private:
+    void run() {
+        try {
+            CSV layout(settings_);
+            layout.transient_ = true;
+            std::unique_ptr<CSV> batch;
+            std::string buf;
+            bool titled = false;
+            for (bool last = false; !last; ) {
+                {
+                    Timer timer(layout.settings_, "csv.read", &ParseStats::io_ns);
+                    last = !in_.read(buf);
+                }
+                const char* p = buf.data();
+                const char* end = p + buf.size();
+                if (!titled) {
+                    p = layout.parseTitle(p, end, last);
+                    if (p == nullptr)
+                        continue;
+                    if (layout.title_.empty())
+                        break;
+                    titled = true;
+                }
+                for (; ; ) {
+                    if (!batch) {
+                        batch.reset(new CSV(layout.settings_));
+                        layout.copyLayout(*batch);
+                    }
+                    p = batch->parseRows(p, end, last, rows_ - batch->rows_);
+                    if (batch->rows_ < rows_)
+                        break;
+                    batch->transient_ = false;
+                    if (!batches_.push(std::move(batch)))
+                        return;
+                }
+                buf.erase(0, p - buf.data());
+            }
+            if (batch && batch->rows_ != 0) {
+                batch->transient_ = false;
+                batches_.push(std::move(batch));
+            }
+        }
+        catch (...) {
+            error_ = std::current_exception();
+        }
+        batches_.close();
+    }
+
+private:
+    Settings settings_;
+    std::size_t rows_;
+    Prefetcher in_;
+    BoundedQueue<std::unique_ptr<CSV>> batches_;
+    std::exception_ptr error_;
+    std::unique_ptr<CSV> batch_;
+    std::size_t count_;
+    std::thread thread_;
+
+}; // class CSV::BatchReader
+
+// Rows appended in blocks, of which at most `resident` stay in memory: the
+// least recently used ones are written to an anonymous temporary file in the
+// snapshot format and read back when accessed. Column types are kept the
+// same across blocks, widened as later blocks need. Not thread-safe.
+class CSV::SpillTable {
+public:
+    explicit SpillTable(std::size_t resident = 4, const Settings& s = Settings()) :
+        settings_(s), resident_(resident == 0 ? 1 : resident), rows_(0), clock_(0), file_(nullptr), file_size_(0),
+        pending_(SIZE_MAX) {
+        settings_.setZeroCopy(false);
+    }
+
+    // Reads src through a BatchReader in blocks of `rows` rows.
+    SpillTable(std::istream& src, const Settings& s, std::size_t rows = 1 << 16, std::size_t resident = 4) :
+        SpillTable(resident, s) {
+        BatchReader reader(src, s, rows);
+        while (reader.next())
+            append(std::move(reader.getBatch()));
+    }
+
+    SpillTable(const SpillTable&) = delete;
+    SpillTable& operator=(const SpillTable&) = delete;
+
+    ~SpillTable() {
+        if (file_ != nullptr)
+            std::fclose(file_);
+    }
+
+    // Adds a block; its titles must match those of the first block.
+    void append(CSV&& block) {
+        if (block.empty())
+            return;
+        settle();
+        if (blocks_.empty()) {
+            title_ = block.title_;
+            settings_.ending_ = block.settings_.ending_;
+        }
+        else if (block.title_ != title_)
+            throw std::runtime_error("tabxx::CSV::SpillTable::append(): Titles differ");
+        if (block.rows_ == 0)
+            return;
+        blocks_.push_back(Block{rows_, block.rows_, std::unique_ptr<CSV>(new CSV(std::move(block))), -1, 0, ++clock_, true});
+        rows_ += blocks_.back().rows;
+        unify(blocks_.size() - 1);
+        evict(blocks_.size() - 1);
+    }
+
+    std::size_t getRowCount() const {
+        return rows_;
+    }
+
+    std::size_t getColumnCount() const {
+        return title_.size();
+    }
+
+    std::vector<std::string> getTitles() const {
+        return title_;
+    }
+
+    std::size_t getBlockCount() const {
+        return blocks_.size();
+    }
+
+    // The type column `column` has in every block.
+    Column::TYPE getColumnType(std::size_t column) {
+        settle();
+        return types_.at(column);
+    }
+
+    // Number of blocks currently in memory.
+    std::size_t getResidentCount() const {
+        std::size_t n = 0;
+        for (auto&& b : blocks_)
+            n += (b.table != nullptr);
+        return n;
+    }
+
+    // Block i, paged in if needed; valid until another block is accessed.
+    // Changes are kept (the block is written again when spilled), but must
+    // not change its row count or titles.
+    CSV& getBlock(std::size_t i) {
+        if (i >= blocks_.size())
+            throw std::out_of_range("tabxx::CSV::SpillTable::getBlock(): Index out of range");
+        CSV& ret = load(i);
+        blocks_[i].dirty = true;
+        pending_ = i;
+        return ret;
+    }
+
+    const std::any getValue(std::size_t column, std::size_t row) {
+        std::size_t i = find(row);
+        return load(i).getValue(column, row - blocks_[i].begin);
+    }
+
+    template <typename V>
+    V getValue(std::size_t column, std::size_t row) {
+        std::size_t i = find(row);
+        return load(i).template getValue<V>(column, row - blocks_[i].begin);
+    }
+
+    const std::any getValue(const std::string& column, std::size_t row) {
+        return getValue(searchTitle(column), row);
+    }
+
+    template <typename V>
+    V getValue(const std::string& column, std::size_t row) {
+        return getValue<V>(searchTitle(column), row);
+    }
+
+    std::vector<std::any> getRow(std::size_t row) {
+        std::size_t i = find(row);
+        return load(i).getRow(row - blocks_[i].begin);
+    }
+
+    std::size_t write(std::ostream& des) {
+        Writer w(des);
+        std::size_t ret = write(w);
+        w.flush();
+        return ret;
+    }
+
+    // Pages the blocks in one after another.
+    std::size_t write(Writer& des) {
+        if (title_.empty())
+            return 0;
+        CSV header(settings_);
+        header.setTitle(title_);
+        std::size_t ret = header.writeTitle(des);
+        for (std::size_t i = 0; i < blocks_.size(); ++i) {
+            CSV& block = load(i);
+            ret += block.writeRows(des, 0, block.rows_);
+        }
+        return ret;
+    }
+
+private:
+    struct Block {
+        std::size_t begin;
+        std::size_t rows;
+        std::unique_ptr<CSV> table; // null while spilled
+        std::int64_t offset;        // position in file_, -1 if never spilled
+        std::size_t size;
+        std::uint64_t used;
+        bool dirty;                 // changed since it was last written
+    };
+
+    static bool seek(std::FILE* f, std::int64_t offset) {
+#if defined(_WIN32)
+        return _fseeki64(f, offset, SEEK_SET) == 0;
+#elif defined(TABXX_CSV_HAS_MMAP)
+        return fseeko(f, static_cast<off_t>(offset), SEEK_SET) == 0;
+#else
+        return offset <= std::numeric_limits<long>::max() && std::fseek(f, static_cast<long>(offset), SEEK_SET) == 0;
+#endif
+    }
+
+    std::size_t searchTitle(const std::string& column) const {
+        auto ite = std::find(title_.begin(), title_.end(), column);
+        if (ite == title_.end())
+            throw std::runtime_error("tabxx::CSV::SpillTable::searchTitle(): Unknown column " + column);
+        return static_cast<std::size_t>(ite - title_.begin());
+    }
+
+    std::size_t find(std::size_t row) const {
+        if (row >= rows_)
+            throw std::out_of_range("tabxx::CSV::SpillTable::find(): Index out of range");
+        auto ite = std::upper_bound(blocks_.begin(), blocks_.end(), row, [](std::size_t r, const Block& b) {
+            return r < b.begin;
+        });
+        return static_cast<std::size_t>(ite - blocks_.begin()) - 1;
+    }
+
+    CSV& load(std::size_t i) {
+        settle();
+        Block& b = blocks_[i];
+        b.used = ++clock_;
+        if (b.table == nullptr) {
+            buffer_.resize(b.size);
+            if (!seek(file_, b.offset) || std::fread(&buffer_[0], 1, b.size, file_) != b.size)
+                throw std::runtime_error("tabxx::CSV::SpillTable::load(): Cannot read spill file");
+            b.table.reset(new CSV(loadSnapshot(buffer_.data(), buffer_.size(), settings_)));
+            conform(i);
+            evict(i);
+        }
+        return *b.table;
+    }
+
+    // Widens the table-wide types to cover resident block i, then gives them
+    // to every resident block; spilled ones get them when paged in.
+    void unify(std::size_t i) {
+        const CSV& block = *blocks_[i].table;
+        types_.resize(block.columns_.size(), Column::NONE);
+        bool changed = false;
+        for (std::size_t j = 0; j < types_.size(); ++j) {
+            Column::TYPE t = unifyTypes(types_[j], block.columns_[j].getType());
+            changed = changed || t != types_[j];
+            types_[j] = t;
+        }
+        for (std::size_t k = 0; k < blocks_.size(); ++k)
+            if (blocks_[k].table != nullptr && (changed || k == i))
+                conform(k);
+    }
+
+    void conform(std::size_t i) {
+        Block& b = blocks_[i];
+        for (std::size_t j = 0; j < types_.size(); ++j) {
+            Column& col = b.table->columns_[j];
+            if (col.getType() != types_[j]) {
+                retype(col, types_[j]);
+                b.dirty = true;
+            }
+        }
+    }
+
+    // A block handed out by getBlock() may have changed its types.
+    void settle() {
+        std::size_t i = pending_;
+        pending_ = SIZE_MAX;
+        if (i != SIZE_MAX && blocks_[i].table != nullptr)
+            unify(i);
+    }
+
+    // Spills least recently used blocks other than `keep` until at most
+    // resident_ blocks are in memory. Unchanged blocks are not written
+    // again; a changed one reuses its old place in the file if it fits.
+    void evict(std::size_t keep) {
+        for (std::size_t n = getResidentCount(); n > resident_; --n) {
+            std::size_t victim = SIZE_MAX;
+            for (std::size_t i = 0; i < blocks_.size(); ++i)
+                if (i != keep && blocks_[i].table != nullptr && (victim == SIZE_MAX || blocks_[i].used < blocks_[victim].used))
+                    victim = i;
+            Block& b = blocks_[victim];
+            if (b.dirty) {
+                if (file_ == nullptr && (file_ = std::tmpfile()) == nullptr)
+                    throw std::runtime_error("tabxx::CSV::SpillTable::evict(): Cannot create spill file");
+                buffer_.clear();
+                Writer w(buffer_);
+                b.table->writeSnapshot(w);
+                w.flush();
+                std::int64_t offset = (b.offset >= 0 && buffer_.size() <= b.size) ? b.offset : file_size_;
+                if (!seek(file_, offset) || std::fwrite(buffer_.data(), 1, buffer_.size(), file_) != buffer_.size() ||
+                    std::fflush(file_) != 0)
+                    throw std::runtime_error("tabxx::CSV::SpillTable::evict(): Cannot write spill file");
+                if (offset == file_size_)
+                    file_size_ += static_cast<std::int64_t>(buffer_.size());
+                b.offset = offset;
+                b.size = buffer_.size();
+                b.dirty = false;
+            }
+            b.table.reset();
+        }
+    }
+
+private:
+    Settings settings_;
+    std::size_t resident_;
+    std::vector<std::string> title_;
+    std::vector<Block> blocks_;
+    std::size_t rows_;
+    std::uint64_t clock_;
+    std::FILE* file_;
+    std::int64_t file_size_;
+    std::string buffer_;
+    std::vector<Column::TYPE> types_;
+    std::size_t pending_; // block last returned by getBlock(), SIZE_MAX if none
+
+}; // class CSV::SpillTable
+
+} // namespace tabxx
+
+#endif // CSV_HPP_